@@ -0,0 +1,92 @@
+// - Count the allocations of exercise09's `task<T>` and `sync_await` instead of guessing them
+//   - includes `exercise09_solution.cpp` itself, with its `main` renamed, so a change there shows up here
+//   - the global `operator new` counts its calls; `expect_allocations(name, expected, func)` fails the program unless
+//     `func` allocated exactly `expected` times
+//   - the expected counts assume every coroutine frame comes from the heap, which holds for GCC; clang may elide
+//     frames (see `exercise09_halo`), so the CTest test is disabled there
+//   - a task allocates its frame and nothing else: an await chain costs one allocation per call, and `sync_await` one
+//     more for its own frame
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <utility>
+
+// Its `main` is renamed and never called, so its missing `return` does not matter. GCC treats the included file as a
+//  header, and would complain about its lambdas ending up in coroutine frames.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#pragma GCC diagnostic ignored "-Wsubobject-linkage"
+#endif
+
+#define main exercise09_solution_main
+#include "exercise09_solution.cpp"
+#undef main
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+bool all_passed = true;
+
+// Runs `func` and checks that it allocated exactly `expected` times, counting the allocations of other threads too.
+template<std::invocable Func>
+void expect_allocations(std::string_view name, std::size_t expected, Func&& func) {
+  const auto before = allocations.load(std::memory_order_relaxed);
+  static_cast<void>(std::forward<Func>(func)());
+  const auto actual = allocations.load(std::memory_order_relaxed) - before;
+
+  if (actual != expected) {
+    all_passed = false;
+  }
+
+  std::cout << (actual == expected ? "ok     " : "FAILED ") << name << ": " << actual << " allocation(s), expected " << expected << '\n';
+}
+
+task<int> answer(int value) {
+  co_return value + 1;
+}
+
+task<int> chain(int calls) {
+  int sum = 0;
+  for (int i = 0; i < calls; ++i) {
+    sum += co_await answer(i);
+  }
+  co_return sum;
+}
+
+int main() {
+  try {
+    expect_allocations("sync_await(answer())", 2, [] { return sync_await(answer(1)); });
+    expect_allocations("sync_await(chain()) of 1'000 co_await answer()", 1'002, [] { return sync_await(chain(1'000)); });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return all_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1056 @@
+// - Coalesce concurrent loads of the same key behind one coroutine
+//   - `co_await cache.get(key, loader)` returns the cached value, joins a load already in flight for the key, or
+//     starts exactly one loader coroutine whose result every concurrent caller shares
+//   - the cache is split into shards, each an open-addressing hash table (linear probing, tombstones) guarded by its
+//     own `async_mutex`, so waiting for a shard suspends instead of blocking a thread
+//   - every shard keeps its entries in least-recently-used order and evicts completed entries once it exceeds its
+//     share of the byte budget; loads in flight are never evicted
+//   - failed loads are not cached, the next `get()` for that key tries again
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <semaphore>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+namespace detail {
+
+struct shared_task_waiter {
+  std::coroutine_handle<> continuation;
+  shared_task_waiter*     next{};
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] shared_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    // Null until first awaited, the promise address once completed, otherwise the most recent waiter.
+    std::atomic<void*>       state{nullptr};
+    std::atomic<std::size_t> references{1};
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          auto& promise = h.promise();
+          auto* waiter  = static_cast<detail::shared_task_waiter*>(promise.state.exchange(&promise, std::memory_order_acq_rel));
+
+          // Resumed waiters may drop the last reference, so only locals are touched from here on. The last waiter is
+          //  resumed through symmetric transfer.
+          while (waiter->next) {
+            std::exchange(waiter, waiter->next)->continuation.resume();
+          }
+
+          return waiter->continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    shared_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  shared_task(const shared_task& other) noexcept
+    : promise_{other.promise_} {
+    promise_->references.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  shared_task(shared_task&& other) noexcept
+    : promise_{std::exchange(other.promise_, nullptr)} {
+  }
+
+  shared_task& operator=(shared_task other) noexcept {
+    std::swap(promise_, other.promise_);
+    return *this;
+  }
+
+  ~shared_task() {
+    if (promise_ && promise_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::coroutine_handle<promise_type>::from_promise(*promise_).destroy();
+    }
+  }
+
+  [[nodiscard]] bool is_ready() const noexcept {
+    return promise_->state.load(std::memory_order_acquire) == promise_;
+  }
+
+  awaiter_of<T> auto operator co_await() const noexcept requires std::is_void_v<T> {
+    return awaiter{{}, *promise_};
+  }
+
+  awaiter_of<const T&> auto operator co_await() const noexcept requires std::move_constructible<T> {
+    return awaiter{{}, *promise_};
+  }
+
+private:
+  struct awaiter : detail::shared_task_waiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return promise.state.load(std::memory_order_acquire) == &promise;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept {
+      continuation = handle;
+
+      void* old = promise.state.load(std::memory_order_acquire);
+      do {
+        if (old == &promise) {
+          return handle;
+        }
+        next = static_cast<detail::shared_task_waiter*>(old);
+      } while (!promise.state.compare_exchange_weak(old, static_cast<detail::shared_task_waiter*>(this), std::memory_order_release,
+                                                    std::memory_order_acquire));
+
+      // The first awaiter starts the task, everybody else just waits for it.
+      if (old == nullptr) {
+        return std::coroutine_handle<promise_type>::from_promise(promise);
+      }
+
+      return std::noop_coroutine();
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_type* promise_;
+
+  shared_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+class async_mutex;
+
+// Owns a locked `async_mutex` and unlocks it on destruction.
+class [[nodiscard]] async_mutex_lock {
+public:
+  explicit async_mutex_lock(async_mutex& mutex) noexcept
+    : mutex_{&mutex} {
+  }
+
+  async_mutex_lock(async_mutex_lock&& other) noexcept
+    : mutex_{std::exchange(other.mutex_, nullptr)} {
+  }
+
+  async_mutex_lock& operator=(async_mutex_lock&&) = delete;
+
+  ~async_mutex_lock();
+
+private:
+  async_mutex* mutex_;
+};
+
+// The state is either `not_locked`, `locked_no_waiters` or the most recently queued waiter. Waiters push themselves onto
+//  that stack; the lock holder moves them over to its private FIFO queue when unlocking, and hands the lock to the first.
+class async_mutex {
+  struct lock_awaiter {
+    async_mutex&            mutex;
+    std::coroutine_handle<> continuation;
+    lock_awaiter*           next{};
+
+    explicit lock_awaiter(async_mutex& m) noexcept
+      : mutex{m} {
+    }
+
+    bool await_ready() const noexcept {
+      return mutex.try_lock();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+      continuation = handle;
+
+      auto old = mutex.state_.load(std::memory_order_acquire);
+      while (true) {
+        if (old == not_locked) {
+          if (mutex.state_.compare_exchange_weak(old, locked_no_waiters, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return false;
+          }
+        } else {
+          next = reinterpret_cast<lock_awaiter*>(old);
+          if (mutex.state_.compare_exchange_weak(old, reinterpret_cast<std::uintptr_t>(this), std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+            return true;
+          }
+        }
+      }
+    }
+
+    async_mutex_lock await_resume() const noexcept {
+      return async_mutex_lock{mutex};
+    }
+  };
+
+public:
+  async_mutex() = default;
+
+  async_mutex(const async_mutex&)            = delete;
+  async_mutex& operator=(const async_mutex&) = delete;
+
+  [[nodiscard]] bool try_lock() noexcept {
+    auto expected = not_locked;
+    return state_.compare_exchange_strong(expected, locked_no_waiters, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  awaiter_of<async_mutex_lock> auto scoped_lock() noexcept {
+    return lock_awaiter{*this};
+  }
+
+  // Resumes the next waiter, if any, inline as the new owner.
+  void unlock() noexcept {
+    auto* head = waiters_;
+    if (head == nullptr) {
+      auto expected = locked_no_waiters;
+      if (state_.compare_exchange_strong(expected, not_locked, std::memory_order_release, std::memory_order_relaxed)) {
+        return;
+      }
+
+      // Take over everybody queued since, reversing them into arrival order.
+      auto* queued = reinterpret_cast<lock_awaiter*>(state_.exchange(locked_no_waiters, std::memory_order_acquire));
+      do {
+        auto* next   = queued->next;
+        queued->next = head;
+        head         = queued;
+        queued       = next;
+      } while (queued != nullptr);
+    }
+
+    waiters_ = head->next;
+    head->continuation.resume();
+  }
+
+private:
+  static constexpr std::uintptr_t not_locked        = 1;
+  static constexpr std::uintptr_t locked_no_waiters = 0;
+
+  std::atomic<std::uintptr_t> state_{not_locked};
+  lock_awaiter*               waiters_{}; // Only touched by the lock holder.
+};
+
+inline async_mutex_lock::~async_mutex_lock() {
+  if (mutex_) {
+    mutex_->unlock();
+  }
+}
+
+namespace detail {
+
+// Rough number of bytes a cached value keeps alive, charged against the cache budget.
+struct approximate_size {
+  template<typename V>
+  std::size_t operator()(const V& value) const noexcept {
+    if constexpr (std::ranges::contiguous_range<const V&> && std::ranges::sized_range<const V&>) {
+      return sizeof(V) + std::ranges::size(value) * sizeof(std::ranges::range_value_t<const V&>);
+    } else {
+      return sizeof(V);
+    }
+  }
+};
+
+} // namespace detail
+
+template<typename Loader, typename K, typename V>
+concept cache_loader = std::invocable<Loader&, const K&> && awaitable<std::invoke_result_t<Loader&, const K&>> &&
+                       std::convertible_to<detail::await_result_t<std::invoke_result_t<Loader&, const K&>>, V>;
+
+template<std::equality_comparable K, std::copy_constructible V, typename Hash = std::hash<K>, typename Sizer = detail::approximate_size>
+class async_cache {
+public:
+  struct statistics {
+    std::size_t hits;      // Served from a completed entry.
+    std::size_t joins;     // Attached to a load already in flight.
+    std::size_t loads;     // Started a loader.
+    std::size_t evictions; // Dropped to stay within budget.
+  };
+
+  // The budget is split evenly over the shards, whose count is rounded up to a power of two.
+  explicit async_cache(std::size_t byte_budget, std::size_t shards = 16, Hash hash = {}, Sizer sizer = {})
+    : shards_(std::bit_ceil(shards))
+    , shard_budget_{byte_budget / shards_.size()}
+    , hash_{std::move(hash)}
+    , sizer_{std::move(sizer)} {
+  }
+
+  template<cache_loader<K, V> Loader>
+  task<V> get(K key, Loader loader) {
+    const auto hash  = mix(hash_(key));
+    auto&      shard = shards_[(hash >> 32) & (shards_.size() - 1)];
+
+    std::optional<shared_task<V>> value;
+    std::uint64_t                 generation = 0; // Set when this call started the load.
+
+    {
+      const auto lock = co_await shard.mutex.scoped_lock();
+
+      if (const auto index = shard.find(key, hash); index != no_node) {
+        auto& entry = *shard.nodes[index];
+        shard.touch(index);
+        (entry.loaded ? hits_ : joins_).fetch_add(1, std::memory_order_relaxed);
+        value.emplace(entry.value);
+      } else {
+        value.emplace(load(std::move(loader), key));
+        generation = shard.insert(key, hash, *value);
+        loads_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    if (generation == 0) {
+      co_return co_await *value;
+    }
+
+    // The caller that started the load accounts for it once it finishes, unless the entry was replaced meanwhile.
+    const V*           result = nullptr;
+    std::exception_ptr failure;
+    try {
+      result = std::addressof(co_await *value);
+    } catch (...) {
+      failure = std::current_exception();
+    }
+
+    {
+      const auto lock = co_await shard.mutex.scoped_lock();
+
+      if (const auto index = shard.find(key, hash); index != no_node && shard.nodes[index]->generation == generation) {
+        if (failure) {
+          shard.erase(index);
+        } else {
+          shard.charge(index, sizer_(*result));
+          evictions_.fetch_add(shard.evict(shard_budget_), std::memory_order_relaxed);
+        }
+      }
+    }
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+
+    co_return *result;
+  }
+
+  [[nodiscard]] statistics stats() const noexcept {
+    return {hits_.load(std::memory_order_relaxed), joins_.load(std::memory_order_relaxed), loads_.load(std::memory_order_relaxed),
+            evictions_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  static constexpr std::uint32_t no_node   = std::numeric_limits<std::uint32_t>::max();
+  static constexpr std::uint32_t empty     = no_node;
+  static constexpr std::uint32_t tombstone = no_node - 1;
+
+  struct node {
+    K              key;
+    shared_task<V> value;
+    std::size_t    hash;
+    std::uint64_t  generation;
+    std::size_t    bytes  = 0;
+    bool           loaded = false;
+    std::uint32_t  newer  = no_node;
+    std::uint32_t  older  = no_node;
+
+    node(K k, shared_task<V> v, std::size_t h, std::uint64_t g)
+      : key{std::move(k)}
+      , value{std::move(v)}
+      , hash{h}
+      , generation{g} {
+    }
+  };
+
+  // Slots index into `nodes`, so growing the table never moves an entry and the recency links stay valid. Only touched
+  //  while holding `mutex`. Aligned to keep neighbouring shards off each other's cache lines.
+  struct alignas(64) cache_shard {
+    async_mutex                      mutex;
+    std::vector<std::uint32_t>       slots = std::vector<std::uint32_t>(16, empty);
+    std::vector<std::optional<node>> nodes;
+    std::vector<std::uint32_t>       free_nodes;
+    std::size_t                      used_slots = 0; // Live entries plus tombstones.
+    std::size_t                      bytes      = 0;
+    std::uint64_t                    generation = 0;
+    std::uint32_t                    newest     = no_node;
+    std::uint32_t                    oldest     = no_node;
+
+    [[nodiscard]] std::size_t mask() const noexcept {
+      return slots.size() - 1;
+    }
+
+    [[nodiscard]] std::uint32_t find(const K& key, std::size_t hash) const {
+      for (auto i = hash & mask();; i = (i + 1) & mask()) {
+        const auto index = slots[i];
+        if (index == empty) {
+          return no_node;
+        }
+        if (index != tombstone && nodes[index]->hash == hash && nodes[index]->key == key) {
+          return index;
+        }
+      }
+    }
+
+    // Expects `key` to be absent; returns the generation identifying the new entry.
+    std::uint64_t insert(const K& key, std::size_t hash, const shared_task<V>& value) {
+      // Tombstones count as used, so probing always ends at an empty slot.
+      if ((used_slots + 1) * 4 > slots.size() * 3) {
+        rehash();
+      }
+
+      std::uint32_t index;
+      if (free_nodes.empty()) {
+        index = static_cast<std::uint32_t>(nodes.size());
+        nodes.emplace_back();
+      } else {
+        index = free_nodes.back();
+        free_nodes.pop_back();
+      }
+      nodes[index].emplace(key, value, hash, ++generation);
+
+      auto i = hash & mask();
+      while (slots[i] != empty && slots[i] != tombstone) {
+        i = (i + 1) & mask();
+      }
+      if (slots[i] == empty) {
+        ++used_slots;
+      }
+      slots[i] = index;
+
+      link_newest(index);
+      return generation;
+    }
+
+    void erase(std::uint32_t index) {
+      auto& entry = *nodes[index];
+
+      auto i = entry.hash & mask();
+      while (slots[i] != index) {
+        i = (i + 1) & mask();
+      }
+      slots[i] = tombstone;
+
+      unlink(index);
+      bytes -= entry.bytes;
+      nodes[index].reset();
+      free_nodes.push_back(index);
+    }
+
+    // Rebuilds the table without tombstones, growing it while more than half of it would be live.
+    void rehash() {
+      const auto live = nodes.size() - free_nodes.size();
+
+      auto size = slots.size();
+      while ((live + 1) * 2 > size) {
+        size *= 2;
+      }
+
+      slots.assign(size, empty);
+      used_slots = live;
+
+      for (std::uint32_t index = 0; index < nodes.size(); ++index) {
+        if (nodes[index]) {
+          auto i = nodes[index]->hash & mask();
+          while (slots[i] != empty) {
+            i = (i + 1) & mask();
+          }
+          slots[i] = index;
+        }
+      }
+    }
+
+    void charge(std::uint32_t index, std::size_t size) noexcept {
+      auto& entry  = *nodes[index];
+      entry.bytes  = size;
+      entry.loaded = true;
+      bytes += size;
+    }
+
+    // Drops the least recently used completed entries until the shard fits `budget`; returns how many were dropped.
+    std::size_t evict(std::size_t budget) {
+      std::size_t evicted = 0;
+      for (auto index = oldest; bytes > budget && index != no_node;) {
+        const auto newer = nodes[index]->newer;
+        if (nodes[index]->loaded) {
+          erase(index);
+          ++evicted;
+        }
+        index = newer;
+      }
+      return evicted;
+    }
+
+    void touch(std::uint32_t index) noexcept {
+      if (index != newest) {
+        unlink(index);
+        link_newest(index);
+      }
+    }
+
+    void link_newest(std::uint32_t index) noexcept {
+      auto& entry = *nodes[index];
+      entry.older = newest;
+      entry.newer = no_node;
+
+      if (newest != no_node) {
+        nodes[newest]->newer = index;
+      } else {
+        oldest = index;
+      }
+      newest = index;
+    }
+
+    void unlink(std::uint32_t index) noexcept {
+      const auto& entry = *nodes[index];
+
+      if (entry.newer != no_node) {
+        nodes[entry.newer]->older = entry.older;
+      } else {
+        newest = entry.older;
+      }
+
+      if (entry.older != no_node) {
+        nodes[entry.older]->newer = entry.newer;
+      } else {
+        oldest = entry.newer;
+      }
+    }
+  };
+
+  std::vector<cache_shard> shards_;
+  std::size_t              shard_budget_;
+  Hash                     hash_;
+  Sizer                    sizer_;
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> joins_{0};
+  std::atomic<std::size_t> loads_{0};
+  std::atomic<std::size_t> evictions_{0};
+
+  // Spreads weak hashes (such as the identity hash of integers) over both the shard and the slot bits.
+  static std::size_t mix(std::size_t hash) noexcept {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  template<typename Loader>
+  static shared_task<V> load(Loader loader, K key) {
+    co_return co_await std::invoke(loader, std::as_const(key));
+  }
+};
+
+std::atomic<int> backend_calls{0};
+
+task<std::string> fetch_profile(int user, std::chrono::milliseconds latency) {
+  ++backend_calls;
+  if (user < 0) {
+    throw std::invalid_argument("No such user");
+  }
+
+  co_await async([latency] { std::this_thread::sleep_for(latency); });
+  co_return "profile of user " + std::to_string(user) + ' ' + std::string(200, '.');
+}
+
+void print(const char* name, const async_cache<int, std::string>::statistics& stats) {
+  std::cout << name << ": " << stats.hits << " hits, " << stats.joins << " joins, " << stats.loads << " loads, " << stats.evictions
+            << " evictions, " << backend_calls << " backend calls\n";
+}
+
+int main() {
+  using namespace std::chrono_literals;
+
+  try {
+    const auto slow = [](int user) { return fetch_profile(user, 50ms); };
+    const auto fast = [](int user) { return fetch_profile(user, 0ms); };
+
+    // A burst of requests for one cold key reaches the backend once.
+    {
+      async_cache<int, std::string> cache{1 << 20};
+      {
+        std::vector<std::jthread> requests;
+        for (int i = 0; i < 32; ++i) {
+          requests.emplace_back([&] { (void)sync_await(cache.get(42, slow)); });
+        }
+      }
+      std::cout << sync_await(cache.get(42, slow)).substr(0, 19) << '\n';
+      print("cold key ", cache.stats());
+    }
+
+    // Failures are handed to every waiter but not remembered.
+    {
+      backend_calls = 0;
+      async_cache<int, std::string> cache{1 << 20};
+      for (int attempt = 0; attempt < 2; ++attempt) {
+        try {
+          (void)sync_await(cache.get(-1, fast));
+        } catch (const std::exception& ex) {
+          std::cout << "Exception caught: " << ex.what() << '\n';
+        }
+      }
+      print("failing  ", cache.stats());
+    }
+
+    // A skewed working set larger than the budget: popular users stay, the long tail gets evicted.
+    {
+      backend_calls = 0;
+      async_cache<int, std::string> cache{64 * 1024, 8};
+      {
+        std::vector<std::jthread> clients;
+        for (unsigned seed = 1; seed <= 8; ++seed) {
+          clients.emplace_back([&, seed] {
+            std::minstd_rand                   random{seed};
+            std::uniform_int_distribution<int> user{0, 999};
+            for (int i = 0; i < 2'000; ++i) {
+              (void)sync_await(cache.get(std::min(user(random), user(random)), fast));
+            }
+          });
+        }
+      }
+      print("skewed   ", cache.stats());
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
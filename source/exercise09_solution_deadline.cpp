@@ -0,0 +1,782 @@
+// - Run requests earliest-deadline-first and drop them once their deadline has passed
+//   - `with_deadline(task, time_point)` attaches a deadline to a task's promise; every task it awaits inherits it,
+//     unless that task already has an earlier one
+//   - `edf_scheduler` resumes ready coroutines in deadline order, coroutines without a deadline come last in FIFO order;
+//     new requests enter through `admit(min_slack)` and only start when no work already in progress is ready; those
+//     with less than `min_slack` left by then are cancelled right away, so that under overload the workers finish
+//     requests instead of starting ones that are bound to miss their deadline
+//   - its timer service wakes sleeping coroutines at their wake time or their deadline, whichever comes first
+//   - a coroutine whose deadline has passed is resumed with a `deadline_exceeded` exception at its next scheduling point,
+//     so late requests give up their share of the workers instead of making every other request late as well
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <semaphore>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+} || requires(T&& t, std::coroutine_handle<> arg) {
+  // `await_suspend` may also be a template over the promise of the awaiting coroutine.
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+using deadline_clock = std::chrono::steady_clock;
+
+inline constexpr auto no_deadline = deadline_clock::time_point::max();
+
+template<task_value_type T>
+class task;
+
+template<task_value_type T>
+task<T> with_deadline(task<T> t, deadline_clock::time_point deadline);
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<>    continuation = std::noop_coroutine();
+    deadline_clock::time_point deadline     = no_deadline;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    // Awaited tasks inherit the deadline of the awaiting coroutine.
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> continuation) const noexcept {
+      if constexpr (requires { continuation.promise().deadline; }) {
+        promise.deadline = std::min(promise.deadline, continuation.promise().deadline);
+      }
+
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  template<task_value_type U>
+  friend task<U> with_deadline(task<U> t, deadline_clock::time_point deadline);
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+// Keeps an earlier deadline already attached to `t`.
+template<task_value_type T>
+task<T> with_deadline(task<T> t, deadline_clock::time_point deadline) {
+  t.promise_->deadline = std::min(t.promise_->deadline, deadline);
+  return t;
+}
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+struct deadline_exceeded : std::runtime_error {
+  deadline_exceeded()
+    : std::runtime_error("Deadline exceeded") {
+  }
+};
+
+class edf_scheduler {
+public:
+  using clock = deadline_clock;
+
+  explicit edf_scheduler(std::size_t threads)
+    : timer_{[this](std::stop_token stop) { run_timers(stop); }} {
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+  }
+
+  // Coroutines still queued or sleeping are never resumed.
+  ~edf_scheduler() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+    timer_.request_stop();
+    ready_changed_.notify_all();
+    timers_changed_.notify_all();
+  }
+
+  // Requeues the awaiting coroutine by its deadline.
+  [[nodiscard]] awaiter_of<void> auto schedule() noexcept {
+    return operation{*this, clock::time_point::min()};
+  }
+
+  // Queues the awaiting coroutine by its deadline, behind everything already in progress. Cancels it if it has less than
+  //  `min_slack` left before its deadline once its turn comes.
+  [[nodiscard]] awaiter_of<void> auto admit(clock::duration min_slack = {}) noexcept {
+    return operation{*this, clock::time_point::min(), min_slack, true};
+  }
+
+  // Resumes the awaiting coroutine at `wake`, unless its deadline comes first.
+  [[nodiscard]] awaiter_of<void> auto sleep_until(clock::time_point wake) noexcept {
+    return operation{*this, wake};
+  }
+
+  [[nodiscard]] awaiter_of<void> auto sleep_for(clock::duration duration) noexcept {
+    return sleep_until(clock::now() + duration);
+  }
+
+private:
+  // Lives in the suspended coroutine's frame until it is resumed.
+  struct operation {
+    edf_scheduler&          scheduler;
+    clock::time_point       wake;
+    clock::time_point       deadline = no_deadline;
+    std::coroutine_handle<> handle;
+    clock::duration         min_slack{};
+    bool                    admission = false;
+    bool                    expired   = false;
+
+    operation(edf_scheduler& s, clock::time_point w, clock::duration slack = {}, bool a = false) noexcept
+      : scheduler{s}
+      , wake{w}
+      , min_slack{slack}
+      , admission{a} {
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    template<typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> h) {
+      if constexpr (requires { h.promise().deadline; }) {
+        deadline = h.promise().deadline;
+      }
+
+      handle = h;
+      scheduler.submit(*this);
+    }
+
+    void await_resume() const {
+      if (expired) {
+        throw deadline_exceeded{};
+      }
+    }
+  };
+
+  struct queued {
+    clock::time_point key;
+    std::uint64_t     sequence;
+    operation*        op;
+
+    // Earliest key first, FIFO among equal keys.
+    friend bool operator>(const queued& lhs, const queued& rhs) noexcept {
+      return std::tie(lhs.key, lhs.sequence) > std::tie(rhs.key, rhs.sequence);
+    }
+  };
+
+  using queue = std::priority_queue<queued, std::vector<queued>, std::greater<>>;
+
+  std::mutex                  mutex_;
+  std::condition_variable_any ready_changed_;
+  std::condition_variable_any timers_changed_;
+  queue                       ready_;      // By deadline.
+  queue                       admissions_; // By deadline, only served while `ready_` is empty.
+  queue                       timers_;     // By the earlier of wake time and deadline.
+  std::uint64_t               sequence_ = 0;
+  std::vector<std::jthread>   workers_;
+  std::jthread                timer_;
+
+  void submit(operation& op) {
+    // A worker may resume and destroy the operation as soon as the lock is released, so nothing may be read from it
+    //  afterwards.
+    const bool due = op.wake <= clock::now();
+    {
+      std::scoped_lock lock{mutex_};
+      if (due) {
+        (op.admission ? admissions_ : ready_).push({op.deadline, sequence_++, &op});
+      } else {
+        timers_.push({std::min(op.wake, op.deadline), sequence_++, &op});
+      }
+    }
+
+    if (due) {
+      ready_changed_.notify_one();
+    } else {
+      timers_changed_.notify_one();
+    }
+  }
+
+  void work(std::stop_token stop) {
+    while (true) {
+      operation* next;
+      {
+        std::unique_lock lock{mutex_};
+        if (!ready_changed_.wait(lock, stop, [&] { return !ready_.empty() || !admissions_.empty(); })) {
+          return;
+        }
+
+        auto& from = ready_.empty() ? admissions_ : ready_;
+        next       = from.top().op;
+        from.pop();
+      }
+
+      if (clock::now() + next->min_slack > next->deadline) {
+        next->expired = true;
+      }
+      next->handle.resume();
+    }
+  }
+
+  // The timer service: moves due sleepers to the ready queue, where those woken by their deadline come first.
+  void run_timers(std::stop_token stop) {
+    std::unique_lock lock{mutex_};
+    while (!stop.stop_requested()) {
+      if (timers_.empty()) {
+        timers_changed_.wait(lock, stop, [&] { return !timers_.empty(); });
+        continue;
+      }
+
+      const auto due = timers_.top().key;
+      if (clock::now() < due) {
+        timers_changed_.wait_until(lock, stop, due, [&] { return timers_.top().key < due; });
+        continue;
+      }
+
+      auto* op = timers_.top().op;
+      timers_.pop();
+
+      op->expired = op->deadline < op->wake;
+      ready_.push({op->deadline, sequence_++, op});
+      ready_changed_.notify_one();
+    }
+  }
+};
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t, std::latch& done) {
+  co_await t;
+  done.count_down();
+}
+
+using clock_type = edf_scheduler::clock;
+
+// Stands in for real CPU-bound work.
+void spin_for(clock_type::duration duration) {
+  const auto end = clock_type::now() + duration;
+  while (clock_type::now() < end) {
+  }
+}
+
+task<void> compute(edf_scheduler& scheduler) {
+  co_await scheduler.schedule();
+  spin_for(std::chrono::microseconds{100});
+}
+
+// Two slices of work around a call to a downstream service. Neither child is given a deadline explicitly.
+task<void> process(edf_scheduler& scheduler) {
+  co_await scheduler.admit(std::chrono::milliseconds{1});
+  co_await compute(scheduler);
+  co_await scheduler.sleep_for(std::chrono::microseconds{300});
+  co_await compute(scheduler);
+}
+
+struct outcome {
+  clock_type::duration latency{};
+  bool                 completed = false;
+};
+
+task<void> handle_request(edf_scheduler& scheduler, clock_type::time_point deadline, outcome& result) {
+  const auto arrival = clock_type::now();
+
+  try {
+    co_await with_deadline(process(scheduler), deadline);
+    result.latency   = clock_type::now() - arrival;
+    result.completed = true;
+  } catch (const deadline_exceeded&) {
+  }
+}
+
+// Open loop: requests arrive on schedule, however far behind the workers are.
+void run_load(std::string_view name, bool deadlines) {
+  using namespace std::chrono_literals;
+
+  constexpr int  requests = 10'000;
+  constexpr auto interval = 80us; // 25% more than two workers can handle.
+  constexpr auto sla      = 5ms;
+
+  std::vector<outcome> results(requests);
+  std::latch           done{requests};
+  {
+    edf_scheduler scheduler{2};
+    const auto    start = clock_type::now();
+
+    for (int i = 0; i < requests; ++i) {
+      const auto arrival = start + i * interval;
+      std::this_thread::sleep_until(arrival);
+      spawn(handle_request(scheduler, deadlines ? arrival + sla : no_deadline, results[static_cast<std::size_t>(i)]), done);
+    }
+
+    done.wait();
+  }
+
+  std::vector<clock_type::duration> latencies;
+  for (const auto& result : results) {
+    if (result.completed) {
+      latencies.push_back(result.latency);
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  const auto within_sla = std::count_if(latencies.begin(), latencies.end(), [&](auto latency) { return latency <= sla; });
+  // When every request was cancelled there is no latency to report.
+  const auto percentile = [&](std::size_t p) -> std::string {
+    if (latencies.empty()) {
+      return "n/a";
+    }
+    return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(latencies[latencies.size() * p / 100]).count()) + "us";
+  };
+
+  std::cout << name << ": " << latencies.size() << " completed, " << within_sla << " within SLA, "
+            << requests - static_cast<int>(latencies.size()) << " cancelled; p50 " << percentile(50) << ", p99 " << percentile(99)
+            << "\n";
+}
+
+int main() {
+  try {
+    run_load("FIFO", false);
+    run_load("EDF ", true);
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,778 @@
+// - Carry expected failures by value instead of as exceptions
+//   - a `task<std::expected<V, E>>` returns errors with `co_return std::unexpected(e)`
+//   - inside such a task, `co_await` on another expected-task with the same `E` yields the plain `V`
+//   - on error, the awaiting task does not resume: the error skips every short-circuiting task above it and becomes
+//     the result of the first awaiter that does not short-circuit
+//   - skipped frames are not unwound; their locals are destroyed when their owners destroy them, as usual
+//   - exceptions keep working as before, through the regular storage
+
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <expected>
+#include <iostream>
+#include <memory>
+#include <semaphore>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  // Defaulted, so that `co_return {}` value-initializes the result.
+  template<typename U = T>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T>
+class task;
+
+namespace detail {
+
+template<typename T>
+struct expected_traits {
+  static constexpr bool is_expected = false;
+};
+
+template<typename V, typename E>
+struct expected_traits<std::expected<V, E>> {
+  static constexpr bool is_expected = true;
+
+  using value_type = V;
+  using error_type = E;
+};
+
+template<typename T>
+concept expected_type = expected_traits<T>::is_expected;
+
+// Awaiting `Task` from a coroutine returning `T` short-circuits when both are expected-tasks with the same error type.
+template<typename T, typename Task>
+concept short_circuits = expected_type<T> && specialization_of<Task, task> && expected_type<typename Task::value_type> &&
+                         std::same_as<typename expected_traits<T>::error_type, typename expected_traits<typename Task::value_type>::error_type>;
+
+// The promise of a short-circuiting task, as seen by the tasks it awaits. `fail` is type-erased, as the awaited task
+//  does not know the value type of its awaiter.
+template<typename E>
+struct error_sink {
+  using fail_function = std::coroutine_handle<> (*)(error_sink&, const E&) noexcept;
+
+  fail_function fail;
+  error_sink*   parent{};      // Set while awaited by another short-circuiting task.
+  bool          failed{false}; // Failed by propagation: the error is the result, but the body never finishes.
+
+  explicit error_sink(fail_function f) noexcept
+    : fail{f} {
+  }
+
+  // Hands `error` to the outermost short-circuiting awaiter and returns the coroutine to resume instead of the awaiting
+  //  one(s). Every task on the way fails with a copy, so that awaiting it again does not resume its abandoned body. The
+  //  error itself stays with the task that failed first, which may be awaited again as well.
+  std::coroutine_handle<> propagate(const E& error) noexcept {
+    auto* target = this;
+    while (target->parent) {
+      target->fail(*target, error);
+      target = target->parent;
+    }
+    return target->fail(*target, error);
+  }
+};
+
+template<typename T, typename Promise>
+struct error_channel {};
+
+template<typename V, typename E, typename Promise>
+struct error_channel<std::expected<V, E>, Promise> : error_sink<E> {
+  error_channel() noexcept
+    : error_sink<E>{&error_channel::fail_with} {
+  }
+
+private:
+  static std::coroutine_handle<> fail_with(error_sink<E>& sink, const E& error) noexcept {
+    auto& promise = static_cast<Promise&>(sink);
+    promise.set_value(std::unexpected(error));
+    sink.failed = true;
+    return promise.continuation;
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  using value_type = T;
+
+  struct promise_type : detail::task_promise_storage<T>, detail::error_channel<T, promise_type> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          auto& promise = h.promise();
+
+          if constexpr (detail::expected_type<T>) {
+            if (promise.parent) {
+              if (auto* error = promise.error()) {
+                return promise.parent->propagate(*error);
+              }
+            }
+          }
+
+          return promise.continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+
+    template<typename Task>
+    requires detail::short_circuits<T, std::remove_cvref_t<Task>>
+    awaiter auto await_transform(Task&& child) noexcept {
+      return short_circuit_awaiter<Task&&>{std::forward<Task>(child), *this};
+    }
+
+    template<typename A>
+    A&& await_transform(A&& awaitable) noexcept {
+      return std::forward<A>(awaitable);
+    }
+
+    // Finished, or failed by propagation while suspended in its body.
+    bool completed() noexcept {
+      if constexpr (detail::expected_type<T>) {
+        if (this->failed) {
+          return true;
+        }
+      }
+      return std::coroutine_handle<promise_type>::from_promise(*this).done();
+    }
+
+    // The error of a completed expected-task, if it failed with one.
+    auto* error() noexcept requires detail::expected_type<T> {
+      auto* result = std::get_if<T>(&this->result_);
+      return result && !result->has_value() ? std::addressof(result->error()) : nullptr;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  template<task_value_type>
+  friend class task;
+
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return promise.completed();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  // Awaits an expected-task on behalf of an expected-task: only resumes the awaiter on success, with the plain value.
+  template<typename Task>
+  struct short_circuit_awaiter {
+    using child_promise = typename std::remove_cvref_t<Task>::promise_type;
+
+    child_promise& child;
+    promise_type&  self;
+
+    short_circuit_awaiter(Task child_task, promise_type& p) noexcept
+      : child{*child_task.promise_}
+      , self{p} {
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+      const auto child_handle = std::coroutine_handle<child_promise>::from_promise(child);
+
+      // Awaited before: fail right away or continue with the stored value.
+      if (child.completed()) {
+        if (auto* error = child.error()) {
+          return self.propagate(*error);
+        }
+        return handle;
+      }
+
+      child.continuation = handle;
+      child.parent       = &self;
+      return child_handle;
+    }
+
+    // Only reached when the child succeeded: on failure, `await_suspend` or the propagation skips the awaiter.
+    decltype(auto) await_resume() const {
+      using child_value = typename detail::expected_traits<typename std::remove_cvref_t<Task>::value_type>::value_type;
+
+      if constexpr (std::is_void_v<child_value>) {
+        (void)child.get();
+      } else if constexpr (std::is_rvalue_reference_v<Task>) {
+        return *std::move(child).get();
+      } else {
+        return *child.get();
+      }
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+enum class lookup_error { not_found, timed_out };
+
+std::string_view to_string(lookup_error error) {
+  switch (error) {
+  case lookup_error::not_found:
+    return "not found";
+  case lookup_error::timed_out:
+    return "timed out";
+  }
+  return "unknown";
+}
+
+struct resource {
+  ~resource() {
+    std::cout << "Resource released\n";
+  }
+};
+
+task<std::expected<int, lookup_error>> find(int key) {
+  if (key < 0) {
+    co_return std::unexpected(lookup_error::not_found);
+  }
+  co_return key * 2;
+}
+
+task<std::expected<void, lookup_error>> check(int key) {
+  if (key > 100) {
+    co_return std::unexpected(lookup_error::timed_out);
+  }
+  co_return {};
+}
+
+task<std::expected<int, lookup_error>> find_both(int first, int second) {
+  const resource guard;
+
+  co_await check(first);
+  const int a = co_await find(first);
+  const int b = co_await find(second);
+
+  std::cout << "Both found\n";
+  co_return a + b;
+}
+
+template<typename V, typename E>
+task<std::expected<V, E>> forward(task<std::expected<V, E>>& lookup) {
+  co_return co_await lookup;
+}
+
+void print(const std::expected<int, lookup_error>& result) {
+  if (result) {
+    std::cout << "Result: " << *result << '\n';
+  } else {
+    std::cout << "Error: " << to_string(result.error()) << '\n';
+  }
+}
+
+task<void> print_lookups() {
+  for (const auto& [first, second] : {std::pair{1, 2}, std::pair{1, -2}, std::pair{101, 2}}) {
+    print(co_await find_both(first, second));
+  }
+
+  // The lookup failed on behalf of `forward`; awaiting it again gives the same error.
+  auto lookup = find_both(1, -2);
+  print(co_await forward(lookup));
+  print(co_await lookup);
+}
+
+task<std::expected<int, std::string>> parse(std::string_view text) {
+  if (text.empty()) {
+    co_return std::unexpected(std::string("Expected a number, but the input was empty"));
+  }
+  co_return static_cast<int>(text.size());
+}
+
+// Every await of the failed task sees the whole error, whether it short-circuits or not.
+task<void> print_parse_errors() {
+  auto parsing = parse("");
+  std::cout << "Error: " << (co_await forward(parsing)).error() << '\n';
+  std::cout << "Error: " << (co_await parsing).error() << '\n';
+  std::cout << "Error: " << (co_await forward(parsing)).error() << '\n';
+}
+
+// Three levels deep, every tenth lookup fails at the bottom.
+namespace throwing {
+
+task<int> leaf(int i) {
+  if (i % 10 == 0) {
+    throw std::runtime_error("Not found");
+  }
+  co_return i;
+}
+
+task<int> middle(int i) {
+  const int value = co_await leaf(i);
+  co_return value + 1;
+}
+
+task<int> top(int i) {
+  const int value = co_await middle(i);
+  co_return value + 1;
+}
+
+task<std::size_t> run(int count) {
+  std::size_t sum = 0;
+  for (int i = 0; i < count; ++i) {
+    try {
+      sum += static_cast<std::size_t>(co_await top(i));
+    } catch (const std::runtime_error&) {
+      ++sum;
+    }
+  }
+  co_return sum;
+}
+
+} // namespace throwing
+
+namespace expected {
+
+task<std::expected<int, lookup_error>> leaf(int i) {
+  if (i % 10 == 0) {
+    co_return std::unexpected(lookup_error::not_found);
+  }
+  co_return i;
+}
+
+task<std::expected<int, lookup_error>> middle(int i) {
+  const int value = co_await leaf(i);
+  co_return value + 1;
+}
+
+task<std::expected<int, lookup_error>> top(int i) {
+  const int value = co_await middle(i);
+  co_return value + 1;
+}
+
+task<std::size_t> run(int count) {
+  std::size_t sum = 0;
+  for (int i = 0; i < count; ++i) {
+    if (const auto result = co_await top(i)) {
+      sum += static_cast<std::size_t>(*result);
+    } else {
+      ++sum;
+    }
+  }
+  co_return sum;
+}
+
+} // namespace expected
+
+template<typename Func>
+void measure(std::string_view name, Func&& func) {
+  const auto start  = std::chrono::steady_clock::now();
+  const auto result = std::forward<Func>(func)();
+  const auto end    = std::chrono::steady_clock::now();
+
+  std::cout << name << ": " << result << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
+}
+
+int main() {
+  try {
+    sync_await(print_lookups());
+    sync_await(print_parse_errors());
+
+    constexpr int count = 1'000'000;
+    measure("throwing", [] { return sync_await(throwing::run(count)); });
+    measure("expected", [] { return sync_await(expected::run(count)); });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,763 @@
+// - Recycle coroutine frames per thread, even when they die on another thread
+//   - frames up to 1KiB come from a free list of the allocating thread, per 64-byte size class
+//   - a frame freed on another thread is pushed onto its owner's lock-free "remote free" stack, which the owner drains
+//     in one batch when its own free list runs dry, so memory returns to the thread (and NUMA node) that touched it
+//   - each free list keeps at most `max_cached` frames, anything beyond goes back to the system
+//   - when a thread exits, its frames still alive elsewhere keep its pool alive until the last one is freed
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <semaphore>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+class frame_pool {
+public:
+  static constexpr std::size_t granularity  = 64;
+  static constexpr std::size_t size_classes = 16;
+  static constexpr std::size_t max_cached   = 1024;
+
+  struct statistics {
+    std::size_t system_allocations; // Served by `::operator new`.
+    std::size_t reused;             // Served from the free list.
+    std::size_t remote_frees;       // Frames returned by other threads.
+    std::size_t cached;             // Currently on the free lists.
+  };
+
+  static void* allocate(std::size_t size) {
+    const auto size_class = class_of(size);
+    auto*      pool       = size_class < size_classes ? local() : nullptr;
+
+    block* frame = pool ? pool->take(size_class) : nullptr;
+    if (frame == nullptr) {
+      frame = static_cast<block*>(::operator new(bytes_of(size_class)));
+      if (pool) {
+        ++pool->system_allocations_;
+      }
+    }
+
+    if (pool) {
+      ++pool->live_;
+    }
+
+    frame->owner      = pool;
+    frame->size_class = size_class;
+    return frame + 1;
+  }
+
+  static void deallocate(void* ptr) noexcept {
+    auto* frame = static_cast<block*>(ptr) - 1;
+    auto* owner = frame->owner;
+
+    if (owner == nullptr) {
+      ::operator delete(frame);
+    } else if (owner == current) {
+      owner->give_back(frame);
+    } else {
+      owner->push_remote(frame);
+    }
+  }
+
+  // Of the calling thread's pool.
+  [[nodiscard]] static statistics local_statistics() {
+    auto* pool = local();
+    if (pool == nullptr) {
+      return {};
+    }
+
+    std::size_t cached = 0;
+    for (const auto& list : pool->free_) {
+      cached += list.count;
+    }
+    return {pool->system_allocations_, pool->reused_, pool->remote_frees_, cached};
+  }
+
+private:
+  // Precedes every frame. While a frame is free, `next` links it into a free list or the remote stack instead.
+  struct block {
+    union {
+      frame_pool* owner;
+      block*      next;
+    };
+    std::size_t size_class;
+  };
+
+  static_assert(sizeof(block) % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+
+  struct free_list {
+    block*      head{};
+    std::size_t count{};
+  };
+
+  enum class thread_state { fresh, active, exited };
+
+  // Only `current` is touched by deallocation, so that frames freed during thread teardown never resurrect the pool.
+  static inline thread_local frame_pool*  current = nullptr;
+  static inline thread_local thread_state state   = thread_state::fresh;
+
+  // Marks a pool whose thread has exited; remote frees then go straight back to the system.
+  static inline block closed_marker{};
+
+  std::array<free_list, size_classes> free_;
+  std::atomic<block*>                 remote_{nullptr};
+  std::atomic<std::size_t>            references_{1}; // The owning thread, plus every outstanding frame once it exits.
+  std::size_t                         live_               = 0;
+  std::size_t                         system_allocations_ = 0;
+  std::size_t                         reused_             = 0;
+  std::size_t                         remote_frees_       = 0;
+
+  static std::size_t class_of(std::size_t size) noexcept {
+    return (size + sizeof(block) - 1) / granularity;
+  }
+
+  static std::size_t bytes_of(std::size_t size_class) noexcept {
+    return (size_class + 1) * granularity;
+  }
+
+  static frame_pool* local() {
+    struct owner {
+      owner() {
+        current = new frame_pool;
+        state   = thread_state::active;
+      }
+
+      ~owner() {
+        state = thread_state::exited;
+        std::exchange(current, nullptr)->abandon();
+      }
+    };
+
+    if (state == thread_state::exited) {
+      return nullptr;
+    }
+
+    thread_local const owner instance;
+    return current;
+  }
+
+  block* take(std::size_t size_class) noexcept {
+    auto& list = free_[size_class];
+    if (list.head == nullptr) {
+      drain_remote();
+    }
+
+    auto* frame = list.head;
+    if (frame) {
+      list.head = frame->next;
+      --list.count;
+      ++reused_;
+    }
+
+    return frame;
+  }
+
+  void give_back(block* frame) noexcept {
+    --live_;
+
+    auto& list = free_[frame->size_class];
+    if (list.count == max_cached) {
+      ::operator delete(frame);
+      return;
+    }
+
+    frame->next = std::exchange(list.head, frame);
+    ++list.count;
+  }
+
+  // Acquires on every read, so that seeing `closed_marker` also makes the references handed out in `abandon` visible.
+  void push_remote(block* frame) noexcept {
+    auto* head = remote_.load(std::memory_order_acquire);
+    do {
+      if (head == &closed_marker) {
+        ::operator delete(frame);
+        release();
+        return;
+      }
+      frame->next = head;
+    } while (!remote_.compare_exchange_weak(head, frame, std::memory_order_release, std::memory_order_acquire));
+  }
+
+  void drain_remote() noexcept {
+    for (auto* frame = remote_.exchange(nullptr, std::memory_order_acquire); frame != nullptr;) {
+      auto* next = frame->next;
+      ++remote_frees_;
+      give_back(frame);
+      frame = next;
+    }
+  }
+
+  // Called on thread exit. Frames alive elsewhere each take over a reference, so they can still find the pool.
+  void abandon() noexcept {
+    drain_remote();
+    for (auto& list : free_) {
+      while (list.head) {
+        ::operator delete(std::exchange(list.head, list.head->next));
+      }
+      list.count = 0;
+    }
+
+    // Hand out the references before closing, so that remote frees racing with us cannot drop the last one.
+    references_.fetch_add(live_, std::memory_order_relaxed);
+    for (auto* frame = remote_.exchange(&closed_marker, std::memory_order_acq_rel); frame != nullptr;) {
+      ::operator delete(std::exchange(frame, frame->next));
+      release();
+    }
+
+    release();
+  }
+
+  void release() noexcept {
+    if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+// Routes the frames of coroutines whose promise derives from this through the frame pool.
+struct pooled_frame {
+  static void* operator new(std::size_t size) {
+    return frame_pool::allocate(size);
+  }
+
+  static void operator delete(void* ptr) noexcept {
+    frame_pool::deallocate(ptr);
+  }
+};
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T>, detail::pooled_frame {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T>, detail::pooled_frame {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+// Bounded blocking queue, handing work from one thread to another.
+template<typename T>
+class handoff_queue {
+public:
+  explicit handoff_queue(std::size_t capacity)
+    : capacity_{capacity} {
+  }
+
+  void push(T value) {
+    {
+      std::unique_lock lock{mutex_};
+      not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+      items_.push_back(std::move(value));
+    }
+    not_empty_.notify_one();
+  }
+
+  T pop() {
+    std::unique_lock lock{mutex_};
+    not_empty_.wait(lock, [&] { return !items_.empty(); });
+    auto value = std::move(items_.front());
+    items_.pop_front();
+    lock.unlock();
+
+    not_full_.notify_one();
+    return value;
+  }
+
+private:
+  std::mutex              mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<T>           items_;
+  std::size_t             capacity_;
+};
+
+task<long> compute(int i) {
+  co_return static_cast<long>(i) * 2;
+}
+
+void print(std::string_view name, const detail::frame_pool::statistics& stats) {
+  std::cout << name << ": " << stats.system_allocations << " system allocations, " << stats.reused << " reused, " << stats.remote_frees
+            << " returned by other threads, " << stats.cached << " cached\n";
+}
+
+int main() {
+  try {
+    constexpr int         count     = 1'000'000;
+    constexpr std::size_t in_flight = 256;
+
+    // Frames are allocated by the producer and destroyed by the consumer.
+    handoff_queue<std::optional<task<long>>> queue{in_flight};
+    detail::frame_pool::statistics           producer_stats{};
+    detail::frame_pool::statistics           consumer_stats{};
+    long                                     sum = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+      std::jthread producer{[&] {
+        for (int i = 0; i < count; ++i) {
+          queue.push(compute(i));
+        }
+        queue.push(std::nullopt);
+        producer_stats = detail::frame_pool::local_statistics();
+      }};
+
+      std::jthread consumer{[&] {
+        while (auto work = queue.pop()) {
+          sum += sync_await(std::move(*work));
+        }
+        consumer_stats = detail::frame_pool::local_statistics();
+      }};
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    std::cout << "Sum: " << sum << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
+    print("producer", producer_stats);
+    print("consumer", consumer_stats);
+
+    // Frames outliving the thread that allocated them keep its pool alive until they are gone.
+    std::vector<task<long>> orphans;
+    std::jthread{[&] {
+      for (int i = 0; i < 100; ++i) {
+        orphans.push_back(compute(i));
+      }
+    }}.join();
+
+    sum = 0;
+    for (const auto& orphan : orphans) {
+      sum += sync_await(orphan);
+    }
+    orphans.clear();
+    std::cout << "Orphans: " << sum << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,507 @@
+// - Let clang keep the frames of awaited tasks inside the awaiting frame (HALO)
+//   - `task<T>` owns its coroutine through a plain `std::coroutine_handle` and destroys it in an inline destructor;
+//     creating, starting and destroying a child task are all visible at the point of `co_await func1()`
+//   - there is no `promise_ptr` deleter and no separate `start()`: the awaiter starts the child by symmetric transfer,
+//     and once `func1()` is inlined, clang can prove the child frame does not outlive the awaiting coroutine and
+//     allocate it as part of that frame instead of on the heap
+//   - with clang 20 and later, `[[clang::coro_await_elidable]]` asks for the same even when `func1()` is not inlined
+//   - `operator new` counts its calls, so the demo shows how many frames of a `co_await` chain were heap-allocated;
+//     built with clang 20 or later and optimizations on, it fails unless all of them were elided; elsewhere it only
+//     reports the counts (the CTest test is only enabled for optimized clang 20+ builds)
+//   - configure with `-DCMAKE_CXX_COMPILER=clang++ -DENABLE_CORO_ELIDE_REMARKS=ON` to see clang's own report
+//   - GCC does not elide coroutine frames at all, so every frame is allocated there
+
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <semaphore>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+// Clang 20 elides the frame of a task that is `co_await`ed right away even without inlining the coroutine first.
+#if defined(__clang__) && __has_cpp_attribute(clang::coro_await_elidable)
+#define TASK_AWAIT_ELIDABLE [[clang::coro_await_elidable]]
+#else
+#define TASK_AWAIT_ELIDABLE
+#endif
+
+template<task_value_type T = void>
+class [[nodiscard]] TASK_AWAIT_ELIDABLE task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+  };
+
+  task(task&& other) noexcept
+    : handle_{std::exchange(other.handle_, nullptr)} {
+  }
+
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  // Inline, so that the destruction of the frame is seen on every path out of the awaiting coroutine.
+  ~task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter{handle_};
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter{handle_};
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->handle.promise()).get();
+      }
+    };
+    return rvalue_awaiter({handle_});
+  }
+
+private:
+  struct awaiter {
+    std::coroutine_handle<promise_type> handle;
+
+    bool await_ready() const noexcept {
+      return handle.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      handle.promise().continuation = continuation;
+      return handle;
+    }
+
+    decltype(auto) await_resume() const {
+      return handle.promise().get();
+    }
+  };
+
+  std::coroutine_handle<promise_type> handle_;
+
+  explicit task(std::coroutine_handle<promise_type> handle) noexcept
+    : handle_{handle} {
+  }
+};
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+task<int> func1(int value) {
+  co_return value + 1;
+}
+
+task<int> func2(int value) {
+  co_return co_await func1(value) * 2;
+}
+
+task<int> func3(int value) {
+  const auto doubled = co_await func2(value);
+  co_return doubled + co_await func1(value);
+}
+
+struct chain_result {
+  long        checksum    = 0;
+  std::size_t allocations = 0;
+  double      ns_per_call = 0;
+};
+
+constexpr int calls = 1'000'000;
+
+// Only the frames created by the awaited chains are counted, not the one of this coroutine or of `sync_await`.
+template<task<int> (*Func)(int)>
+task<chain_result> run() {
+  chain_result result;
+
+  const auto before = allocations;
+  const auto start  = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    result.checksum += co_await Func(i);
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  result.allocations = allocations - before;
+  result.ns_per_call = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+  co_return result;
+}
+
+// Only an optimized clang with `coro_await_elidable` is sure to elide; elsewhere the counts are just reported.
+#if defined(__clang__) && defined(__OPTIMIZE__) && __has_cpp_attribute(clang::coro_await_elidable)
+constexpr bool expect_elision = true;
+#else
+constexpr bool expect_elision = false;
+#endif
+
+// True if every frame of the chain was elided.
+bool report(const char* name, int frames, const chain_result& result) {
+  const auto heap_frames = static_cast<double>(result.allocations) / calls;
+  std::cout << name << ": " << frames << " frame(s) per call, " << heap_frames << " heap-allocated, " << result.ns_per_call
+            << "ns per call" << (result.allocations == 0 ? " (all elided)" : "") << '\n';
+  return result.allocations == 0;
+}
+
+int main() {
+  try {
+    const bool func1_elided = report("co_await func1()", 1, sync_await(run<func1>()));
+    const bool func3_elided = report("co_await func3()", 4, sync_await(run<func3>()));
+
+    if (expect_elision && !(func1_elided && func3_elided)) {
+      return EXIT_FAILURE;
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,1268 @@
+// - Keep coroutines on the NUMA node of the data they work on
+//   - `numa_topology::discover()` reads the nodes, their CPUs and their distances from /sys/devices/system/node;
+//     `numa_topology::parse("0-3;4-7")` simulates a topology, so that all of this can be tried on a single-node machine
+//   - `numa_pool` runs a worker per CPU, pinned to the CPUs of its node, and gives every node its own run queue
+//   - `co_await pool.schedule_on_node(n)` continues the current coroutine on node `n` and is never moved elsewhere;
+//     `async(pool, func)` runs `func` on the node of the awaiting coroutine
+//   - idle workers steal `async` work from other nodes only once their own queue is empty, nearest nodes first
+//   - coroutine frames come from the per-thread frame pools, which only ever hold memory of their worker's node
+//     thanks to the pinning; frames freed on another node go back to the thread that allocated them
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <semaphore>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+class frame_pool {
+public:
+  static constexpr std::size_t granularity  = 64;
+  static constexpr std::size_t size_classes = 16;
+  static constexpr std::size_t max_cached   = 1024;
+
+  struct statistics {
+    std::size_t system_allocations; // Served by `::operator new`.
+    std::size_t reused;             // Served from the free list.
+    std::size_t remote_frees;       // Frames returned by other threads.
+    std::size_t cached;             // Currently on the free lists.
+  };
+
+  static void* allocate(std::size_t size) {
+    const auto size_class = class_of(size);
+    auto*      pool       = size_class < size_classes ? local() : nullptr;
+
+    block* frame = pool ? pool->take(size_class) : nullptr;
+    if (frame == nullptr) {
+      frame = static_cast<block*>(::operator new(bytes_of(size_class)));
+      if (pool) {
+        ++pool->system_allocations_;
+      }
+    }
+
+    if (pool) {
+      ++pool->live_;
+    }
+
+    frame->owner      = pool;
+    frame->size_class = size_class;
+    return frame + 1;
+  }
+
+  static void deallocate(void* ptr) noexcept {
+    auto* frame = static_cast<block*>(ptr) - 1;
+    auto* owner = frame->owner;
+
+    if (owner == nullptr) {
+      ::operator delete(frame);
+    } else if (owner == current) {
+      owner->give_back(frame);
+    } else {
+      owner->push_remote(frame);
+    }
+  }
+
+  // Of the calling thread's pool.
+  [[nodiscard]] static statistics local_statistics() {
+    auto* pool = local();
+    if (pool == nullptr) {
+      return {};
+    }
+
+    std::size_t cached = 0;
+    for (const auto& list : pool->free_) {
+      cached += list.count;
+    }
+    return {pool->system_allocations_, pool->reused_, pool->remote_frees_, cached};
+  }
+
+private:
+  // Precedes every frame. While a frame is free, `next` links it into a free list or the remote stack instead.
+  struct block {
+    union {
+      frame_pool* owner;
+      block*      next;
+    };
+    std::size_t size_class;
+  };
+
+  static_assert(sizeof(block) % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+
+  struct free_list {
+    block*      head{};
+    std::size_t count{};
+  };
+
+  enum class thread_state { fresh, active, exited };
+
+  // Only `current` is touched by deallocation, so that frames freed during thread teardown never resurrect the pool.
+  static inline thread_local frame_pool*  current = nullptr;
+  static inline thread_local thread_state state   = thread_state::fresh;
+
+  // Marks a pool whose thread has exited; remote frees then go straight back to the system.
+  static inline block closed_marker{};
+
+  std::array<free_list, size_classes> free_;
+  std::atomic<block*>                 remote_{nullptr};
+  std::atomic<std::size_t>            references_{1}; // The owning thread, plus every outstanding frame once it exits.
+  std::size_t                         live_               = 0;
+  std::size_t                         system_allocations_ = 0;
+  std::size_t                         reused_             = 0;
+  std::size_t                         remote_frees_       = 0;
+
+  static std::size_t class_of(std::size_t size) noexcept {
+    return (size + sizeof(block) - 1) / granularity;
+  }
+
+  static std::size_t bytes_of(std::size_t size_class) noexcept {
+    return (size_class + 1) * granularity;
+  }
+
+  static frame_pool* local() {
+    struct owner {
+      owner() {
+        current = new frame_pool;
+        state   = thread_state::active;
+      }
+
+      ~owner() {
+        state = thread_state::exited;
+        std::exchange(current, nullptr)->abandon();
+      }
+    };
+
+    if (state == thread_state::exited) {
+      return nullptr;
+    }
+
+    thread_local const owner instance;
+    return current;
+  }
+
+  block* take(std::size_t size_class) noexcept {
+    auto& list = free_[size_class];
+    if (list.head == nullptr) {
+      drain_remote();
+    }
+
+    auto* frame = list.head;
+    if (frame) {
+      list.head = frame->next;
+      --list.count;
+      ++reused_;
+    }
+
+    return frame;
+  }
+
+  void give_back(block* frame) noexcept {
+    --live_;
+
+    auto& list = free_[frame->size_class];
+    if (list.count == max_cached) {
+      ::operator delete(frame);
+      return;
+    }
+
+    frame->next = std::exchange(list.head, frame);
+    ++list.count;
+  }
+
+  // Whoever reads `closed_marker` here also sees the references `abandon` added before publishing it.
+  void push_remote(block* frame) noexcept {
+    auto* head = remote_.load(std::memory_order_acquire);
+    do {
+      if (head == &closed_marker) {
+        ::operator delete(frame);
+        release();
+        return;
+      }
+      frame->next = head;
+    } while (!remote_.compare_exchange_weak(head, frame, std::memory_order_release, std::memory_order_acquire));
+  }
+
+  void drain_remote() noexcept {
+    for (auto* frame = remote_.exchange(nullptr, std::memory_order_acquire); frame != nullptr;) {
+      auto* next = frame->next;
+      ++remote_frees_;
+      give_back(frame);
+      frame = next;
+    }
+  }
+
+  // Called on thread exit. Frames alive elsewhere each take over a reference, so they can still find the pool.
+  void abandon() noexcept {
+    drain_remote();
+    for (auto& list : free_) {
+      while (list.head) {
+        ::operator delete(std::exchange(list.head, list.head->next));
+      }
+      list.count = 0;
+    }
+
+    // Hand out the references before closing, so that remote frees racing with us cannot drop the last one.
+    references_.fetch_add(live_, std::memory_order_relaxed);
+    for (auto* frame = remote_.exchange(&closed_marker, std::memory_order_acq_rel); frame != nullptr;) {
+      ::operator delete(std::exchange(frame, frame->next));
+      release();
+    }
+
+    release();
+  }
+
+  void release() noexcept {
+    if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+// Routes the frames of coroutines whose promise derives from this through the frame pool.
+struct pooled_frame {
+  static void* operator new(std::size_t size) {
+    return frame_pool::allocate(size);
+  }
+
+  static void operator delete(void* ptr) noexcept {
+    frame_pool::deallocate(ptr);
+  }
+};
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T>, detail::pooled_frame {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+struct numa_node {
+  unsigned              id;
+  std::vector<unsigned> cpus;
+  std::vector<unsigned> distances; // To every node of the topology by index, 10 meaning local as in the ACPI SLIT.
+};
+
+class numa_topology {
+public:
+  // Only nodes with CPUs are of interest. Without any NUMA information, all CPUs form a single node.
+  static numa_topology discover(const std::filesystem::path& root = "/sys/devices/system/node") {
+    std::vector<numa_node> nodes;
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator{root, error}) {
+      const auto name = entry.path().filename().string();
+
+      unsigned id{};
+      if (name.starts_with("node") && parse_number(std::string_view{name}.substr(4), id)) {
+        nodes.push_back({id, parse_cpu_list(read_line(entry.path() / "cpulist")), parse_distances(read_line(entry.path() / "distance"))});
+      }
+    }
+
+    std::ranges::sort(nodes, {}, &numa_node::id);
+
+    // The distances list every node, memory-only ones included.
+    std::vector<std::size_t> with_cpus;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      if (!nodes[i].cpus.empty()) {
+        with_cpus.push_back(i);
+      }
+    }
+
+    numa_topology topology;
+    for (const auto i : with_cpus) {
+      auto& node = nodes[i];
+      if (node.distances.size() == nodes.size()) {
+        std::vector<unsigned> distances;
+        for (const auto j : with_cpus) {
+          distances.push_back(node.distances[j]);
+        }
+        node.distances = std::move(distances);
+      } else {
+        node.distances = default_distances(with_cpus.size(), topology.nodes_.size());
+      }
+      topology.nodes_.push_back(std::move(node));
+    }
+
+    if (topology.nodes_.empty()) {
+      numa_node all{0, {}, {local_distance}};
+      for (unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1U); ++cpu) {
+        all.cpus.push_back(cpu);
+      }
+      topology.nodes_.push_back(std::move(all));
+    }
+
+    return topology;
+  }
+
+  // One CPU list per node, separated by semicolons, e.g. "0-3,8-11;4-7,12-15". Remote nodes are all equally far.
+  static numa_topology parse(std::string_view config) {
+    const auto lists = split(config, ';');
+
+    numa_topology topology;
+    for (const auto list : lists) {
+      const auto id = static_cast<unsigned>(topology.nodes_.size());
+      auto       cpus = parse_cpu_list(list);
+      if (cpus.empty()) {
+        throw std::invalid_argument{"numa_topology: node " + std::to_string(id) + " has no CPUs"};
+      }
+      topology.nodes_.push_back({id, std::move(cpus), default_distances(lists.size(), id)});
+    }
+
+    if (topology.nodes_.empty()) {
+      throw std::invalid_argument{"numa_topology: no nodes"};
+    }
+    return topology;
+  }
+
+  [[nodiscard]] const std::vector<numa_node>& nodes() const noexcept {
+    return nodes_;
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    return nodes_.size();
+  }
+
+  [[nodiscard]] std::optional<std::size_t> node_of_cpu(unsigned cpu) const noexcept {
+    for (std::size_t i = 0; i < nodes_.size(); ++i) {
+      if (std::ranges::find(nodes_[i].cpus, cpu) != nodes_[i].cpus.end()) {
+        return i;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  static constexpr unsigned local_distance  = 10;
+  static constexpr unsigned remote_distance = 20;
+
+  std::vector<numa_node> nodes_;
+
+  static std::vector<unsigned> default_distances(std::size_t count, std::size_t self) {
+    std::vector<unsigned> distances(count, remote_distance);
+    distances[self] = local_distance;
+    return distances;
+  }
+
+  static std::string read_line(const std::filesystem::path& path) {
+    std::ifstream in{path};
+    std::string   line;
+    std::getline(in, line);
+    return line;
+  }
+
+  static std::vector<std::string_view> split(std::string_view text, char separator) {
+    std::vector<std::string_view> parts;
+    while (!text.empty()) {
+      const auto end = std::min(text.find(separator), text.size());
+      if (end > 0) {
+        parts.push_back(text.substr(0, end));
+      }
+      text.remove_prefix(std::min(end + 1, text.size()));
+    }
+    return parts;
+  }
+
+  static bool parse_number(std::string_view text, unsigned& value) noexcept {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size() && !text.empty();
+  }
+
+  // The kernel's format: comma separated CPUs and inclusive CPU ranges, e.g. "0-3,8".
+  static std::vector<unsigned> parse_cpu_list(std::string_view list) {
+    std::vector<unsigned> cpus;
+    for (const auto range : split(list, ',')) {
+      const auto dash  = std::min(range.find('-'), range.size());
+      unsigned   first = 0;
+      unsigned   last  = 0;
+      if (!parse_number(range.substr(0, dash), first) || !parse_number(dash < range.size() ? range.substr(dash + 1) : range, last) ||
+          last < first) {
+        throw std::invalid_argument{"numa_topology: invalid CPU list '" + std::string{list} + "'"};
+      }
+
+      for (auto cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    return cpus;
+  }
+
+  static std::vector<unsigned> parse_distances(std::string_view line) {
+    std::vector<unsigned> distances;
+    for (const auto field : split(line, ' ')) {
+      unsigned distance{};
+      if (!parse_number(field, distance)) {
+        return {};
+      }
+      distances.push_back(distance);
+    }
+    return distances;
+  }
+};
+
+class numa_pool {
+public:
+  struct statistics {
+    std::size_t executed; // Jobs run by the workers of the node.
+    std::size_t stolen;   // Of those, taken from the queue of another node.
+  };
+
+  explicit numa_pool(numa_topology topology)
+    : topology_{std::move(topology)}
+    , queues_(topology_.size())
+    , steal_order_(topology_.size())
+    , started_{static_cast<std::ptrdiff_t>(cpu_count(topology_))} {
+    for (std::size_t node = 0; node < topology_.size(); ++node) {
+      for (std::size_t other = 0; other < topology_.size(); ++other) {
+        if (other != node) {
+          steal_order_[node].push_back(other);
+        }
+      }
+
+      const auto& distances = topology_.nodes()[node].distances;
+      std::ranges::stable_sort(steal_order_[node], {}, [&](std::size_t other) { return distances[other]; });
+    }
+
+    for (std::size_t node = 0; node < topology_.size(); ++node) {
+      for (std::size_t i = 0; i < topology_.nodes()[node].cpus.size(); ++i) {
+        workers_.emplace_back([this, node](std::stop_token stop) { work(node, stop); });
+      }
+    }
+
+    started_.wait();
+  }
+
+  numa_pool(const numa_pool&)            = delete;
+  numa_pool& operator=(const numa_pool&) = delete;
+
+  ~numa_pool() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+  }
+
+  [[nodiscard]] const numa_topology& topology() const noexcept {
+    return topology_;
+  }
+
+  [[nodiscard]] std::size_t worker_count() const noexcept {
+    return workers_.size();
+  }
+
+  // Simulated topologies may name CPUs this machine does not have.
+  [[nodiscard]] std::size_t pinned_workers() const noexcept {
+    return pinned_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] statistics node_statistics(std::size_t node) const noexcept {
+    const auto& queue = queues_[node];
+    return {queue.executed.load(std::memory_order_relaxed), queue.stolen.load(std::memory_order_relaxed)};
+  }
+
+  // The node of the calling worker; for any other thread the node of the CPU it currently runs on.
+  [[nodiscard]] std::size_t local_node() const noexcept {
+    if (current.pool == this) {
+      return current.node;
+    }
+
+    const int cpu = ::sched_getcpu();
+    return cpu < 0 ? 0 : topology_.node_of_cpu(static_cast<unsigned>(cpu)).value_or(0);
+  }
+
+  // Continues the awaiting coroutine on a worker of `node`, right away when already running on one.
+  [[nodiscard]] awaiter_of<void> auto schedule_on_node(std::size_t node) {
+    if (node >= queues_.size()) {
+      throw std::out_of_range{"numa_pool: no node " + std::to_string(node)};
+    }
+
+    struct operation {
+      numa_pool&  pool;
+      std::size_t node;
+
+      bool await_ready() const noexcept {
+        return current.pool == &pool && current.node == node;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        pool.push(node, {resume, handle.address()}, lane::bound);
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    return operation{*this, node};
+  }
+
+  // Runs `run(context)` on a worker of `node`, or of the nearest node with an idle worker when all of its own are busy.
+  void execute(std::size_t node, void (*run)(void*), void* context) {
+    push(node, {run, context}, lane::shared);
+  }
+
+private:
+  struct job {
+    void (*run)(void*);
+    void* context;
+  };
+
+  enum class lane { bound, shared };
+
+  struct alignas(64) run_queue {
+    std::mutex                  mutex;
+    std::condition_variable_any wake;
+    std::deque<job>             bound;  // Only for the workers of this node.
+    std::deque<job>             shared; // Also for idle workers of other nodes.
+    std::size_t                 sleeping       = 0;
+    std::size_t                 steal_requests = 0; // Sleeping workers asked to look for work on other nodes.
+    std::atomic<std::size_t>    executed{0};
+    std::atomic<std::size_t>    stolen{0};
+  };
+
+  struct worker_context {
+    const numa_pool* pool;
+    std::size_t      node;
+  };
+
+  static inline thread_local worker_context current{nullptr, 0};
+
+  numa_topology                         topology_;
+  std::vector<run_queue>                queues_;
+  std::vector<std::vector<std::size_t>> steal_order_; // Per node, the other nodes nearest first.
+  std::atomic<std::size_t>              pinned_{0};
+  std::latch                            started_; // Counts down once per worker when it is pinned.
+  std::vector<std::jthread>             workers_;
+
+  static std::size_t cpu_count(const numa_topology& topology) noexcept {
+    std::size_t count = 0;
+    for (const auto& node : topology.nodes()) {
+      count += node.cpus.size();
+    }
+    return count;
+  }
+
+  static void resume(void* address) {
+    std::coroutine_handle<>::from_address(address).resume();
+  }
+
+  void push(std::size_t node, job next, lane to) {
+    auto& queue = queues_[node];
+
+    bool idle = false;
+    {
+      std::scoped_lock lock{queue.mutex};
+      (to == lane::bound ? queue.bound : queue.shared).push_back(next);
+      idle = queue.sleeping > queue.steal_requests;
+    }
+
+    if (idle) {
+      queue.wake.notify_one();
+    } else if (to == lane::shared) {
+      request_steal(node);
+    }
+  }
+
+  // All workers of `node` are busy, so a sleeping worker of the nearest node that has one comes to help.
+  void request_steal(std::size_t node) {
+    for (const auto other : steal_order_[node]) {
+      auto& queue = queues_[other];
+      {
+        std::scoped_lock lock{queue.mutex};
+        if (queue.sleeping <= queue.steal_requests) {
+          continue;
+        }
+        ++queue.steal_requests;
+      }
+
+      queue.wake.notify_one();
+      return;
+    }
+  }
+
+  // The node's own work comes first, and coroutines already running on it before new work.
+  static std::optional<job> pop(run_queue& queue, bool own) {
+    std::scoped_lock lock{queue.mutex};
+
+    auto& jobs = own && !queue.bound.empty() ? queue.bound : queue.shared;
+    if (jobs.empty()) {
+      return std::nullopt;
+    }
+
+    const auto next = jobs.front();
+    jobs.pop_front();
+    return next;
+  }
+
+  std::optional<job> take(std::size_t node) {
+    auto& own = queues_[node];
+    if (auto next = pop(own, true)) {
+      own.executed.fetch_add(1, std::memory_order_relaxed);
+      return next;
+    }
+
+    for (const auto other : steal_order_[node]) {
+      if (auto next = pop(queues_[other], false)) {
+        own.executed.fetch_add(1, std::memory_order_relaxed);
+        own.stolen.fetch_add(1, std::memory_order_relaxed);
+        return next;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Pins to the whole node rather than a single CPU, leaving the balancing within the node to the kernel.
+  void pin(const std::vector<unsigned>& cpus) noexcept {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+
+    if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0) {
+      pinned_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void work(std::size_t node, std::stop_token stop) {
+    // Before anything gets allocated, so that the thread's frame pool is filled from memory of its node.
+    pin(topology_.nodes()[node].cpus);
+    current = {this, node};
+    started_.count_down();
+
+    auto& own = queues_[node];
+    while (true) {
+      if (const auto next = take(node)) {
+        next->run(next->context);
+        continue;
+      }
+
+      std::unique_lock lock{own.mutex};
+      ++own.sleeping;
+      const bool woken = own.wake.wait(lock, stop, [&] { return !own.bound.empty() || !own.shared.empty() || own.steal_requests > 0; });
+      --own.sleeping;
+      if (own.steal_requests > 0) {
+        --own.steal_requests;
+      }
+
+      if (!woken) {
+        return;
+      }
+    }
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  async(numa_pool& pool, F&& func)
+    : pool_{pool}
+    , func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async&                  awaitable;
+      std::coroutine_handle<> handle;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> h) {
+        handle = h;
+        awaitable.pool_.execute(awaitable.pool_.local_node(), run, this);
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+
+      static void run(void* context) {
+        auto& self = *static_cast<awaiter*>(context);
+        try {
+          if constexpr (std::is_void_v<return_type>) {
+            self.awaitable.func_();
+          } else {
+            self.awaitable.result_.set_value(self.awaitable.func_());
+          }
+        } catch (...) {
+          self.awaitable.result_.set_exception(std::current_exception());
+        }
+
+        self.handle.resume();
+      }
+    };
+
+    return awaiter{*this, {}};
+  }
+
+private:
+  numa_pool&           pool_;
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(numa_pool&, F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T>, detail::pooled_frame {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t, std::latch& done) {
+  co_await t;
+  done.count_down();
+}
+
+// Every node owns one shard. It is filled by a worker of that node, so the kernel places its pages there (first touch).
+class sharded_table {
+public:
+  sharded_table(numa_pool& pool, std::size_t entries_per_shard)
+    : shards_(pool.topology().size()) {
+    std::latch filled{static_cast<std::ptrdiff_t>(shards_.size())};
+    for (std::size_t node = 0; node < shards_.size(); ++node) {
+      spawn(fill(pool, node, entries_per_shard), filled);
+    }
+    filled.wait();
+  }
+
+  [[nodiscard]] const std::vector<std::uint64_t>& shard(std::size_t node) const noexcept {
+    return shards_[node];
+  }
+
+private:
+  std::vector<std::vector<std::uint64_t>> shards_;
+
+  task<void> fill(numa_pool& pool, std::size_t node, std::size_t entries) {
+    co_await pool.schedule_on_node(node);
+
+    auto& shard = shards_[node];
+    shard.resize(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+      shard[i] = i + node;
+    }
+  }
+};
+
+struct load_result {
+  std::chrono::milliseconds elapsed;
+  std::uint64_t             sum;
+  std::size_t               misplaced; // Requests that did not run on the node they were scheduled on.
+};
+
+// Sums a scattered stretch of the shard of `owner`, running on node `on`.
+task<void> handle_request(numa_pool& pool, const sharded_table& table, std::size_t owner, std::size_t on, std::size_t first,
+                          std::atomic<std::uint64_t>& sum, std::atomic<std::size_t>& misplaced) {
+  co_await pool.schedule_on_node(on);
+  if (pool.local_node() != on) {
+    misplaced.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  constexpr std::size_t stride = 8; // One cache line.
+
+  const auto&   shard = table.shard(owner);
+  std::uint64_t total = 0;
+  for (std::size_t i = 0, at = first % shard.size(); i < 4'096; ++i, at = (at + stride * 97) % shard.size()) {
+    total += shard[at];
+  }
+
+  sum.fetch_add(total, std::memory_order_relaxed);
+}
+
+// `local` runs every request on the node owning its shard, otherwise on the next node.
+load_result run_load(numa_pool& pool, const sharded_table& table, std::size_t requests, bool local) {
+  const auto nodes = pool.topology().size();
+
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::size_t>   misplaced{0};
+  std::latch                 done{static_cast<std::ptrdiff_t>(requests)};
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < requests; ++i) {
+    const auto owner = i % nodes;
+    spawn(handle_request(pool, table, owner, local ? owner : (owner + 1) % nodes, i * 7'919, sum, misplaced), done);
+  }
+  done.wait();
+  const auto end = std::chrono::steady_clock::now();
+
+  return {std::chrono::duration_cast<std::chrono::milliseconds>(end - start), sum.load(), misplaced.load()};
+}
+
+// Stands in for real CPU-bound work.
+std::uint64_t busy_work(std::uint64_t value, std::size_t rounds) {
+  for (std::size_t i = 0; i < rounds; ++i) {
+    value = value * 6'364'136'223'846'793'005ULL + 1;
+    value ^= value >> 29;
+  }
+  return value;
+}
+
+// All the `async` work is submitted on node 0, idle workers of the other nodes steal it from there.
+task<void> offload(numa_pool& pool, std::uint64_t seed, std::atomic<std::uint64_t>& sum) {
+  co_await pool.schedule_on_node(0);
+  const auto result = co_await async(pool, [seed] { return busy_work(seed, 200'000); });
+  sum.fetch_add(result, std::memory_order_relaxed);
+}
+
+void print(const numa_topology& topology) {
+  for (const auto& node : topology.nodes()) {
+    std::cout << "node " << node.id << ": " << node.cpus.size() << " CPUs, distances";
+    for (const auto distance : node.distances) {
+      std::cout << ' ' << distance;
+    }
+    std::cout << '\n';
+  }
+}
+
+void print(std::string_view name, const load_result& result) {
+  std::cout << name << ": " << result.elapsed.count() << "ms, sum " << result.sum << ", " << result.misplaced << " misplaced\n";
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    // A topology such as "0-3;4-7" simulates two nodes, e.g. "0;0" even on a single CPU.
+    const auto topology = argc > 1 ? numa_topology::parse(argv[1]) : numa_topology::discover();
+    print(topology);
+
+    {
+      numa_pool pool{topology};
+      std::cout << "pinned " << pool.pinned_workers() << " of " << pool.worker_count() << " workers\n";
+
+      const sharded_table table{pool, std::size_t{1} << 22};
+      print("owner node", run_load(pool, table, 20'000, true));
+      print("other node", run_load(pool, table, 20'000, false));
+    }
+
+    numa_pool pool{topology};
+
+    constexpr std::size_t      jobs = 64;
+    std::atomic<std::uint64_t> sum{0};
+    std::latch                 done{jobs};
+    for (std::size_t i = 0; i < jobs; ++i) {
+      spawn(offload(pool, i, sum), done);
+    }
+    done.wait();
+
+    std::cout << "offloaded to node 0:";
+    for (std::size_t node = 0; node < topology.size(); ++node) {
+      const auto stats = pool.node_statistics(node);
+      std::cout << " node " << node << " ran " << stats.executed << " (" << stats.stolen << " stolen)";
+    }
+    std::cout << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
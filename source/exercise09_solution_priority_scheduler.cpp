@@ -0,0 +1,669 @@
+// - Let latency-sensitive coroutines overtake background work
+//   - `priority_scheduler` runs coroutines on a few worker threads from three lanes: high, normal and low
+//   - `co_await scheduler.schedule(priority::high)` requeues the current coroutine on the high lane; long running work
+//     awaits `schedule()` between chunks to give way
+//   - anti-starvation aging: every `aging_step` spent waiting lifts a coroutine one priority level, so low priority work
+//     that waited two steps goes ahead of fresh high priority work, even when high priority work alone saturates the workers
+//   - the benchmark compares interactive request latency with and without priorities under background compaction
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+enum class priority : std::uint8_t { high, normal, low };
+
+class priority_scheduler {
+public:
+  using clock = std::chrono::steady_clock;
+
+  priority_scheduler(std::size_t threads, clock::duration aging_step)
+    : aging_step_{aging_step} {
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+  }
+
+  // Coroutines still queued are never resumed.
+  ~priority_scheduler() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+    ready_.notify_all();
+  }
+
+  [[nodiscard]] awaiter_of<void> auto schedule(priority level) noexcept {
+    struct schedule_awaiter : std::suspend_always {
+      priority_scheduler& scheduler;
+      priority            level;
+
+      void await_suspend(std::coroutine_handle<> handle) const {
+        scheduler.enqueue(handle, level);
+      }
+    };
+
+    return schedule_awaiter{{}, *this, level};
+  }
+
+private:
+  struct entry {
+    std::coroutine_handle<> handle;
+    clock::time_point       enqueued;
+  };
+
+  static constexpr std::size_t lanes = 3;
+
+  clock::duration                       aging_step_;
+  std::mutex                            mutex_;
+  std::condition_variable_any           ready_;
+  std::array<std::deque<entry>, lanes>  queues_;
+  std::size_t                           queued_ = 0;
+  std::vector<std::jthread>             workers_;
+
+  void enqueue(std::coroutine_handle<> handle, priority level) {
+    {
+      std::scoped_lock lock{mutex_};
+      queues_[static_cast<std::size_t>(level)].push_back({handle, clock::now()});
+      ++queued_;
+    }
+    ready_.notify_one();
+  }
+
+  // Within a lane the front has waited longest, so only the fronts compete. Every `aging_step` a front has waited lifts
+  //  it one level; the highest level wins, and among equals the one promoted from furthest down, as it has waited for it.
+  std::coroutine_handle<> pop_next() {
+    const auto now = clock::now();
+
+    std::size_t best       = lanes;
+    std::size_t best_level = lanes;
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+      if (queues_[lane].empty()) {
+        continue;
+      }
+
+      const auto steps = static_cast<std::size_t>((now - queues_[lane].front().enqueued) / aging_step_);
+      const auto level = lane - std::min(lane, steps);
+      if (level <= best_level) {
+        best       = lane;
+        best_level = level;
+      }
+    }
+
+    const auto handle = queues_[best].front().handle;
+    queues_[best].pop_front();
+    --queued_;
+    return handle;
+  }
+
+  void work(std::stop_token stop) {
+    while (true) {
+      std::coroutine_handle<> next;
+      {
+        std::unique_lock lock{mutex_};
+        if (!ready_.wait(lock, stop, [&] { return queued_ > 0; })) {
+          return;
+        }
+        next = pop_next();
+      }
+      next.resume();
+    }
+  }
+};
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t, std::latch& done) {
+  co_await t;
+  done.count_down();
+}
+
+using clock_type = priority_scheduler::clock;
+
+// Stands in for real CPU-bound work.
+void spin_for(clock_type::duration duration) {
+  const auto end = clock_type::now() + duration;
+  while (clock_type::now() < end) {
+  }
+}
+
+task<void> handle_request(priority_scheduler& scheduler, priority level, clock_type::duration& latency) {
+  const auto submitted = clock_type::now();
+
+  co_await scheduler.schedule(level);
+  spin_for(std::chrono::microseconds{50});
+
+  latency = clock_type::now() - submitted;
+}
+
+task<void> compact(priority_scheduler& scheduler, priority level, int chunks, clock_type::time_point& finished) {
+  for (int chunk = 0; chunk < chunks; ++chunk) {
+    co_await scheduler.schedule(level);
+    spin_for(std::chrono::microseconds{500});
+  }
+
+  finished = clock_type::now();
+}
+
+struct load {
+  int                  requests;
+  clock_type::duration interval;
+  int                  chunks; // Per compaction.
+  clock_type::duration aging_step;
+};
+
+struct load_result {
+  std::vector<clock_type::duration> latencies;
+  clock_type::duration              background;
+};
+
+load_result run_load(const load& config, priority interactive, priority background) {
+  constexpr int compactions = 8;
+
+  load_result                         result{std::vector<clock_type::duration>(static_cast<std::size_t>(config.requests)), {}};
+  std::vector<clock_type::time_point> finished(compactions);
+  std::latch                          done{config.requests + compactions};
+
+  priority_scheduler scheduler{2, config.aging_step};
+  const auto         start = clock_type::now();
+
+  for (int i = 0; i < compactions; ++i) {
+    spawn(compact(scheduler, background, config.chunks, finished[static_cast<std::size_t>(i)]), done);
+  }
+
+  // Open loop: requests arrive on schedule, regardless of how far behind the scheduler is.
+  for (int i = 0; i < config.requests; ++i) {
+    std::this_thread::sleep_until(start + i * config.interval);
+    spawn(handle_request(scheduler, interactive, result.latencies[static_cast<std::size_t>(i)]), done);
+  }
+
+  done.wait();
+  result.background = *std::max_element(finished.begin(), finished.end()) - start;
+  return result;
+}
+
+void print(std::string_view name, load_result result) {
+  std::sort(result.latencies.begin(), result.latencies.end());
+
+  const auto percentile = [&](std::size_t p) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(result.latencies[result.latencies.size() * p / 100]).count();
+  };
+
+  std::cout << name << ": interactive p50 " << percentile(50) << "us, p99 " << percentile(99) << "us; background done after "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(result.background).count() << "ms\n";
+}
+
+int main() {
+  using namespace std::chrono_literals;
+
+  try {
+    const load mixed{2'000, 500us, 250, 10ms};
+    print("equal              ", run_load(mixed, priority::normal, priority::normal));
+    print("prioritized        ", run_load(mixed, priority::high, priority::low));
+
+    // Interactive requests alone keep both workers busy: only aging lets compaction make progress meanwhile.
+    const load overload{20'000, 25us, 25, 10ms};
+    print("overload, no aging ", run_load({overload.requests, overload.interval, overload.chunks, 1h}, priority::high, priority::low));
+    print("overload, aging    ", run_load(overload, priority::high, priority::low));
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,880 @@
+// - Serve connections straight from `task<T>` coroutines using an epoll reactor
+//   - one reactor per thread, optionally one per core sharing a port via `SO_REUSEPORT`
+//   - `co_await sock.accept()`, `co_await sock.recv(buffer)` and `co_await sock.send(buffer)`
+//   - operations are attempted speculatively and only suspend on `EAGAIN`
+//   - the reactor completes the operation on readiness and resumes the waiting coroutine directly
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <syncstream>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<std::convertible_to<T> U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) {
+    this->set_value(std::forward<U>(value));
+  }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  auto operator co_await() const& noexcept {
+    return awaiter(*promise_);
+  }
+
+  auto operator co_await() const&& noexcept requires(!std::is_void_v<T>) {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+// Fire-and-forget coroutine owning itself; used to launch connection handlers on a reactor.
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t) {
+  try {
+    co_await t;
+  } catch (const std::system_error& ex) {
+    if (ex.code() != std::errc::operation_canceled) {
+      std::osyncstream(std::cerr) << "Detached task failed: " << ex.what() << '\n';
+    }
+  } catch (const std::exception& ex) {
+    std::osyncstream(std::cerr) << "Detached task failed: " << ex.what() << '\n';
+  }
+}
+
+[[noreturn]] void throw_errno(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+namespace detail {
+
+// A pending socket operation. The reactor calls `try_complete` on readiness and resumes `handle` once it stops
+//  reporting `EAGAIN`.
+struct io_operation {
+  std::coroutine_handle<> handle;
+  bool (*try_complete)(io_operation&) noexcept;
+  int error = 0;
+};
+
+// Attached sockets form an intrusive list so pending operations can be cancelled when the reactor stops.
+struct io_state {
+  int           fd = -1;
+  io_operation* reader{};
+  io_operation* writer{};
+  io_state*     prev{};
+  io_state*     next{};
+};
+
+} // namespace detail
+
+class async_socket;
+
+class reactor {
+public:
+  reactor()
+    : epoll_fd_{::epoll_create1(EPOLL_CLOEXEC)}
+    , wake_fd_{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)} {
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+      throw_errno("reactor");
+    }
+
+    epoll_event event{.events = EPOLLIN, .data = {.ptr = nullptr}};
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) < 0) {
+      throw_errno("epoll_ctl");
+    }
+  }
+
+  reactor(const reactor&)            = delete;
+  reactor& operator=(const reactor&) = delete;
+
+  ~reactor() {
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+  }
+
+  // Runs the event loop on the calling thread until `stop()` is called.
+  void run() {
+    std::array<epoll_event, 256> events;
+
+    while (!stopped_.load(std::memory_order_acquire)) {
+      const int count = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw_errno("epoll_wait");
+      }
+
+      for (const auto& event : std::span(events.data(), static_cast<std::size_t>(count))) {
+        if (event.data.ptr == nullptr) {
+          std::uint64_t value{};
+          [[maybe_unused]] const auto n = ::read(wake_fd_, &value, sizeof(value));
+          continue;
+        }
+
+        dispatch(*static_cast<detail::io_state*>(event.data.ptr), event.events);
+      }
+
+      // Sockets closed while handling this batch may still be referenced by later events in it.
+      retired_.clear();
+    }
+
+    cancel_pending();
+  }
+
+  // Thread-safe; wakes up the event loop if it is blocked in `epoll_wait`.
+  void stop() noexcept {
+    stopped_.store(true, std::memory_order_release);
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const auto n = ::write(wake_fd_, &value, sizeof(value));
+  }
+
+private:
+  friend async_socket;
+
+  int                                            epoll_fd_;
+  int                                            wake_fd_;
+  std::atomic<bool>                              stopped_{false};
+  detail::io_state*                              attached_{};
+  std::vector<std::unique_ptr<detail::io_state>> retired_;
+
+  static void dispatch(detail::io_state& state, std::uint32_t events) noexcept {
+    constexpr std::uint32_t failure = EPOLLERR | EPOLLHUP;
+
+    // Both operations are completed before either coroutine resumes, as resuming may close the socket.
+    detail::io_operation* reader = nullptr;
+    detail::io_operation* writer = nullptr;
+
+    if (state.reader && (events & (EPOLLIN | EPOLLRDHUP | failure)) && state.reader->try_complete(*state.reader)) {
+      reader = std::exchange(state.reader, nullptr);
+    }
+
+    if (state.writer && (events & (EPOLLOUT | failure)) && state.writer->try_complete(*state.writer)) {
+      writer = std::exchange(state.writer, nullptr);
+    }
+
+    if (reader) {
+      reader->handle.resume();
+    }
+
+    if (writer) {
+      writer->handle.resume();
+    }
+  }
+
+  // Fails every pending operation with `ECANCELED` so suspended coroutines unwind and release their frames. Runs
+  //  until no operations are left, as unwinding coroutines may start new ones.
+  void cancel_pending() {
+    std::vector<detail::io_operation*> cancelled;
+
+    do {
+      cancelled.clear();
+      for (auto* state = attached_; state; state = state->next) {
+        for (auto* op : {std::exchange(state->reader, nullptr), std::exchange(state->writer, nullptr)}) {
+          if (op) {
+            op->error = ECANCELED;
+            cancelled.push_back(op);
+          }
+        }
+      }
+
+      for (auto* op : cancelled) {
+        op->handle.resume();
+      }
+      retired_.clear();
+    } while (!cancelled.empty());
+  }
+
+  std::unique_ptr<detail::io_state> attach(int fd) {
+    auto state = std::make_unique<detail::io_state>(detail::io_state{.fd = fd});
+
+    // Edge-triggered: operations always try the syscall first, so a missed edge is never a missed wakeup.
+    epoll_event event{.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data = {.ptr = state.get()}};
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+      ::close(fd);
+      throw_errno("epoll_ctl");
+    }
+
+    state->next = std::exchange(attached_, state.get());
+    if (state->next) {
+      state->next->prev = state.get();
+    }
+
+    return state;
+  }
+
+  void retire(std::unique_ptr<detail::io_state> state) {
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, state->fd, nullptr);
+    ::close(std::exchange(state->fd, -1));
+    state->reader = state->writer = nullptr;
+
+    (state->prev ? state->prev->next : attached_) = state->next;
+    if (state->next) {
+      state->next->prev = state->prev;
+    }
+
+    retired_.push_back(std::move(state));
+  }
+};
+
+namespace detail {
+
+template<typename Derived>
+struct io_awaiter : io_operation {
+  io_state* state;
+
+  explicit io_awaiter(io_state& s) noexcept
+    : io_operation{{}, [](io_operation& op) noexcept { return static_cast<Derived&>(op).try_once(); }, 0}
+    , state{&s} {
+  }
+
+  bool await_ready() noexcept {
+    return static_cast<Derived*>(this)->try_once();
+  }
+
+  // Returns true when the operation finished (or failed) and false when it has to wait for readiness.
+  bool complete(ssize_t result) noexcept {
+    if (result >= 0) {
+      return true;
+    }
+
+    if (errno == EAGAIN || errno == EINPROGRESS) {
+      return false;
+    }
+
+    error = errno;
+    return true;
+  }
+
+  void check() const {
+    if (error == ECANCELED) {
+      throw std::system_error(std::make_error_code(std::errc::operation_canceled));
+    }
+
+    if (error != 0) {
+      throw std::system_error(error, std::generic_category(), "socket");
+    }
+  }
+};
+
+} // namespace detail
+
+class async_socket {
+public:
+  async_socket(reactor& r, int fd)
+    : reactor_{&r}
+    , state_{r.attach(fd)} {
+  }
+
+  async_socket(async_socket&&) noexcept = default;
+  async_socket& operator=(async_socket&&) = delete;
+
+  ~async_socket() {
+    if (state_) {
+      reactor_->retire(std::move(state_));
+    }
+  }
+
+  [[nodiscard]] int native_handle() const noexcept {
+    return state_->fd;
+  }
+
+  [[nodiscard]] auto accept() noexcept {
+    struct awaiter : detail::io_awaiter<awaiter> {
+      reactor* r;
+      int      fd = -1;
+
+      awaiter(detail::io_state& s, reactor& owner) noexcept
+        : io_awaiter(s)
+        , r{&owner} {
+      }
+
+      bool try_once() noexcept {
+        fd = ::accept4(state->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        return complete(fd);
+      }
+
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        handle        = h;
+        state->reader = this;
+      }
+
+      async_socket await_resume() const {
+        check();
+        return {*r, fd};
+      }
+    };
+
+    return awaiter{*state_, *reactor_};
+  }
+
+  [[nodiscard]] auto recv(std::span<std::byte> buffer) noexcept {
+    struct awaiter : detail::io_awaiter<awaiter> {
+      std::span<std::byte> buffer;
+      ssize_t              bytes = 0;
+
+      awaiter(detail::io_state& s, std::span<std::byte> b) noexcept
+        : io_awaiter(s)
+        , buffer{b} {
+      }
+
+      bool try_once() noexcept {
+        bytes = ::recv(state->fd, buffer.data(), buffer.size(), 0);
+        return complete(bytes);
+      }
+
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        handle        = h;
+        state->reader = this;
+      }
+
+      // Zero means the peer closed the connection.
+      std::size_t await_resume() const {
+        check();
+        return static_cast<std::size_t>(bytes);
+      }
+    };
+
+    return awaiter{*state_, buffer};
+  }
+
+  [[nodiscard]] auto send(std::span<const std::byte> buffer) noexcept {
+    struct awaiter : detail::io_awaiter<awaiter> {
+      std::span<const std::byte> buffer;
+      ssize_t                    bytes = 0;
+
+      awaiter(detail::io_state& s, std::span<const std::byte> b) noexcept
+        : io_awaiter(s)
+        , buffer{b} {
+      }
+
+      bool try_once() noexcept {
+        bytes = ::send(state->fd, buffer.data(), buffer.size(), MSG_NOSIGNAL);
+        return complete(bytes);
+      }
+
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        handle        = h;
+        state->writer = this;
+      }
+
+      // May be less than the buffer size; see `send_all`.
+      std::size_t await_resume() const {
+        check();
+        return static_cast<std::size_t>(bytes);
+      }
+    };
+
+    return awaiter{*state_, buffer};
+  }
+
+  [[nodiscard]] auto connect(const sockaddr* address, socklen_t length) noexcept {
+    struct awaiter : detail::io_awaiter<awaiter> {
+      const sockaddr* address;
+      socklen_t       length;
+      bool            started = false;
+
+      awaiter(detail::io_state& s, const sockaddr* a, socklen_t l) noexcept
+        : io_awaiter(s)
+        , address{a}
+        , length{l} {
+      }
+
+      bool try_once() noexcept {
+        if (!std::exchange(started, true)) {
+          return complete(::connect(state->fd, address, length));
+        }
+
+        socklen_t size = sizeof(error);
+        if (::getsockopt(state->fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0) {
+          error = errno;
+        }
+        return true;
+      }
+
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        handle        = h;
+        state->writer = this;
+      }
+
+      void await_resume() const {
+        check();
+      }
+    };
+
+    return awaiter{*state_, address, length};
+  }
+
+private:
+  reactor*                          reactor_;
+  std::unique_ptr<detail::io_state> state_;
+};
+
+task<void> send_all(async_socket& sock, std::span<const std::byte> buffer) {
+  while (!buffer.empty()) {
+    buffer = buffer.subspan(co_await sock.send(buffer));
+  }
+}
+
+namespace detail {
+
+int make_socket(int domain) {
+  const int fd = ::socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw_errno("socket");
+  }
+  return fd;
+}
+
+sockaddr_in loopback_address(std::uint16_t port) {
+  sockaddr_in address{};
+  address.sin_family      = AF_INET;
+  address.sin_port        = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return address;
+}
+
+sockaddr_un unix_address(std::string_view path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  return address;
+}
+
+} // namespace detail
+
+// Pass `reuse_port` to let one listener per reactor thread share the port; the kernel balances connections.
+async_socket listen_tcp(reactor& r, std::uint16_t port, bool reuse_port = false) {
+  async_socket listener{r, detail::make_socket(AF_INET)};
+  const int    fd      = listener.native_handle();
+  const int    one     = 1;
+  const auto   address = detail::loopback_address(port);
+
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (reuse_port) {
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  }
+
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+    throw_errno("listen_tcp");
+  }
+
+  return listener;
+}
+
+async_socket listen_unix(reactor& r, std::string_view path) {
+  async_socket listener{r, detail::make_socket(AF_UNIX)};
+  const auto   address = detail::unix_address(path);
+
+  ::unlink(address.sun_path);
+  if (::bind(listener.native_handle(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+      || ::listen(listener.native_handle(), SOMAXCONN) < 0) {
+    throw_errno("listen_unix");
+  }
+
+  return listener;
+}
+
+task<async_socket> connect_tcp(reactor& r, std::uint16_t port) {
+  async_socket sock{r, detail::make_socket(AF_INET)};
+  const auto   address = detail::loopback_address(port);
+  co_await sock.connect(reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+
+  const int one = 1;
+  ::setsockopt(sock.native_handle(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  co_return sock;
+}
+
+task<async_socket> connect_unix(reactor& r, std::string_view path) {
+  async_socket sock{r, detail::make_socket(AF_UNIX)};
+  const auto   address = detail::unix_address(path);
+  co_await sock.connect(reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+  co_return sock;
+}
+
+task<void> echo(async_socket sock) {
+  std::array<std::byte, 4096> buffer;
+
+  while (const auto bytes = co_await sock.recv(buffer)) {
+    co_await send_all(sock, std::span(buffer).first(bytes));
+  }
+}
+
+task<void> serve(async_socket listener) {
+  while (true) {
+    spawn(echo(co_await listener.accept()));
+  }
+}
+
+// Runs `serve` on its own thread and reactor. Failing to listen is rethrown from the constructor.
+class echo_server {
+public:
+  template<typename Listen>
+  explicit echo_server(Listen listen)
+    : thread_{[this, listen] {
+      try {
+        spawn(serve(listen(reactor_)));
+      } catch (...) {
+        error_ = std::current_exception();
+      }
+
+      ready_.test_and_set();
+      ready_.notify_one();
+      if (!error_) {
+        reactor_.run();
+      }
+    }} {
+    ready_.wait(false);
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+  ~echo_server() {
+    reactor_.stop();
+  }
+
+private:
+  reactor            reactor_;
+  std::atomic_flag   ready_;
+  std::exception_ptr error_;
+  std::jthread       thread_;
+};
+
+task<void> say_hello(reactor& r, task<async_socket> connecting, std::string_view name) {
+  try {
+    auto sock = co_await std::move(connecting);
+
+    const std::string_view message = "Hello, reactor!";
+    co_await send_all(sock, std::as_bytes(std::span(message)));
+
+    std::array<char, 64> reply{};
+    std::size_t          received = 0;
+    while (received < message.size()) {
+      const auto bytes = co_await sock.recv(std::as_writable_bytes(std::span(reply).subspan(received)));
+      if (bytes == 0) {
+        throw std::runtime_error("Connection closed by server");
+      }
+      received += bytes;
+    }
+
+    std::cout << name << " echo: " << std::string_view(reply.data(), received) << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << name << " failed: " << ex.what() << '\n';
+  }
+
+  r.stop();
+}
+
+struct benchmark_stats {
+  std::vector<std::chrono::nanoseconds> latencies;
+  std::size_t                           remaining = 0;
+};
+
+task<void> ping_pong(reactor& r, std::uint16_t port, std::size_t rounds, benchmark_stats& stats) {
+  auto sock = co_await connect_tcp(r, port);
+
+  std::array<std::byte, 64> message{};
+  std::array<std::byte, 64> reply{};
+
+  for (std::size_t i = 0; i < rounds; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    co_await send_all(sock, message);
+
+    std::size_t received = 0;
+    while (received < reply.size()) {
+      const auto bytes = co_await sock.recv(std::span(reply).subspan(received));
+      if (bytes == 0) {
+        throw std::runtime_error("Connection closed by server");
+      }
+      received += bytes;
+    }
+
+    stats.latencies.push_back(std::chrono::steady_clock::now() - start);
+  }
+}
+
+task<void> client(reactor& r, std::uint16_t port, std::size_t rounds, benchmark_stats& stats) {
+  try {
+    co_await ping_pong(r, port, rounds, stats);
+  } catch (const std::exception& ex) {
+    std::cout << "Client failed: " << ex.what() << '\n';
+  }
+
+  if (--stats.remaining == 0) {
+    r.stop();
+  }
+}
+
+// Every connection is a client coroutine on one reactor, the server runs `threads` reactors sharing the port.
+void benchmark(std::size_t connections, std::size_t rounds, std::size_t threads) {
+  rlimit limit{};
+  if (::getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+    throw_errno("getrlimit");
+  }
+  if (limit.rlim_cur != limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    if (::setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+      throw_errno("setrlimit");
+    }
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+      throw_errno("getrlimit");
+    }
+  }
+
+  // Each connection needs a descriptor on both ends, the reactors and listeners keep a few for themselves.
+  constexpr rlim_t reserved = 64;
+  if (limit.rlim_cur <= reserved + 1) {
+    throw std::runtime_error("Not enough file descriptors for a benchmark connection");
+  }
+  connections = std::min<std::size_t>(connections, (limit.rlim_cur - reserved) / 2);
+
+  constexpr std::uint16_t port = 38'465;
+
+  std::vector<std::unique_ptr<echo_server>> servers;
+  for (std::size_t i = 0; i < threads; ++i) {
+    servers.push_back(std::make_unique<echo_server>([](reactor& r) { return listen_tcp(r, port, true); }));
+  }
+
+  reactor         r;
+  benchmark_stats stats;
+  stats.remaining = connections;
+  stats.latencies.reserve(connections * rounds);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < connections; ++i) {
+    spawn(client(r, port, rounds, stats));
+  }
+  r.run();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+  if (stats.latencies.empty()) {
+    throw std::runtime_error("No round trip completed");
+  }
+
+  std::ranges::sort(stats.latencies);
+  const auto percentile = [&](double p) {
+    const auto index = static_cast<std::size_t>(p * static_cast<double>(stats.latencies.size() - 1));
+    return std::chrono::duration_cast<std::chrono::microseconds>(stats.latencies[index]).count();
+  };
+
+  const auto round_trips = static_cast<double>(stats.latencies.size());
+  std::cout << "Loopback: " << connections << " connections x " << rounds << " round trips, " << threads << " server thread(s)\n"
+            << "  " << static_cast<std::uint64_t>(round_trips / elapsed.count()) << " round trips/s, "
+            << static_cast<std::uint64_t>(round_trips * 2 * 64 / elapsed.count() / 1024) << " KiB/s\n"
+            << "  latency p50 " << percentile(0.50) << "us, p99 " << percentile(0.99) << "us, max " << percentile(1.0) << "us\n";
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    {
+      echo_server server{[](reactor& r) { return listen_tcp(r, 38'464); }};
+      reactor     r;
+      spawn(say_hello(r, connect_tcp(r, 38'464), "TCP"));
+      r.run();
+    }
+
+    {
+      constexpr std::string_view path = "/tmp/exercise09_reactor.sock";
+      echo_server                server{[=](reactor& r) { return listen_unix(r, path); }};
+      reactor                    r;
+      spawn(say_hello(r, connect_unix(r, path), "Unix"));
+      r.run();
+      ::unlink(path.data());
+    }
+
+    const std::size_t connections = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10'000;
+    const std::size_t rounds      = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+    const std::size_t threads     = std::max(1U, std::thread::hardware_concurrency() / 2);
+    benchmark(connections, rounds, threads);
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+    return EXIT_FAILURE;
+  }
+}
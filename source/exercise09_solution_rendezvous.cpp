@@ -0,0 +1,814 @@
+// - Let coroutines meet up without parking a thread
+//   - `async_manual_reset_event`: `co_await event.wait()` suspends until `set()`, which resumes all waiters at once
+//   - `async_latch`: `co_await latch.wait()` suspends until `count_down()` has brought the count to zero
+//   - `async_barrier`: `co_await barrier.arrive_and_wait()` suspends until all participants of the phase have arrived
+//     and the completion coroutine of the phase has finished; it can be used for any number of phases
+//   - each keeps its waiters on a lock-free stack inside their awaiters, topped by a single atomic state word, and
+//     resumes all of them in one sweep on the thread that releases them
+
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <semaphore>
+#include <stdexcept>
+#include <syncstream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+namespace detail {
+
+// A suspended coroutine on a lock-free waiter stack, living in its awaiter.
+struct waiter_node {
+  waiter_node*            next = nullptr;
+  std::coroutine_handle<> handle;
+};
+
+// Each resumed coroutine may end its awaiter right away, so the next node is read before.
+inline void resume_all(waiter_node* waiters) {
+  while (waiters) {
+    std::exchange(waiters, waiters->next)->handle.resume();
+  }
+}
+
+// A count and a waiter stack in one state word. User space addresses fit into the lower 48 bits on x86-64 and AArch64;
+//  the upper ones hold the count.
+inline constexpr int            count_shift  = 48;
+inline constexpr std::uintptr_t pointer_mask = (std::uintptr_t{1} << count_shift) - 1;
+inline constexpr std::size_t    max_count    = (std::size_t{1} << (64 - count_shift)) - 1;
+
+static_assert(sizeof(std::uintptr_t) == 8);
+
+inline waiter_node* top_of(std::uintptr_t state) noexcept {
+  return reinterpret_cast<waiter_node*>(state & pointer_mask);
+}
+
+// Runs the completion of a barrier phase, then continues with the coroutine that arrived last. Destroys itself.
+struct phase_completion {
+  struct promise_type {
+    std::coroutine_handle<> continuation;
+
+    phase_completion get_return_object() noexcept {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          const auto continuation = h.promise().continuation;
+          h.destroy();
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+} // namespace detail
+
+class async_manual_reset_event {
+public:
+  explicit async_manual_reset_event(bool initially_set = false) noexcept
+    : state_{initially_set ? this : nullptr} {
+  }
+
+  async_manual_reset_event(const async_manual_reset_event&)            = delete;
+  async_manual_reset_event& operator=(const async_manual_reset_event&) = delete;
+
+  [[nodiscard]] bool is_set() const noexcept {
+    return state_.load(std::memory_order_acquire) == this;
+  }
+
+  // Resumes every waiter on the calling thread.
+  void set() noexcept {
+    if (void* old = state_.exchange(this, std::memory_order_acq_rel); old != this) {
+      detail::resume_all(static_cast<detail::waiter_node*>(old));
+    }
+  }
+
+  void reset() noexcept {
+    void* expected = this;
+    state_.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] awaiter_of<void> auto wait() noexcept {
+    struct wait_awaiter {
+      async_manual_reset_event& event;
+      detail::waiter_node       node;
+
+      bool await_ready() const noexcept {
+        return event.is_set();
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        node.handle = handle;
+
+        void* old = event.state_.load(std::memory_order_acquire);
+        do {
+          if (old == &event) {
+            return false;
+          }
+          node.next = static_cast<detail::waiter_node*>(old);
+        } while (!event.state_.compare_exchange_weak(old, &node, std::memory_order_release, std::memory_order_acquire));
+
+        return true;
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    return wait_awaiter{*this, {}};
+  }
+
+private:
+  // `this` when set, otherwise the top of the waiter stack.
+  std::atomic<void*> state_;
+};
+
+class async_latch {
+public:
+  explicit async_latch(std::ptrdiff_t count)
+    : state_{initial_state(count)} {
+  }
+
+  async_latch(const async_latch&)            = delete;
+  async_latch& operator=(const async_latch&) = delete;
+
+  // The call that brings the count to zero resumes every waiter.
+  void count_down(std::ptrdiff_t n = 1) noexcept {
+    auto           old     = state_.load(std::memory_order_acquire);
+    std::uintptr_t desired = 0;
+    do {
+      const auto count = old >> detail::count_shift;
+      if (count == 0) {
+        return;
+      }
+      desired = count <= static_cast<std::uintptr_t>(n) ? 0 : old - (static_cast<std::uintptr_t>(n) << detail::count_shift);
+    } while (!state_.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_acquire));
+
+    if (desired == 0) {
+      detail::resume_all(detail::top_of(old));
+    }
+  }
+
+  [[nodiscard]] bool try_wait() const noexcept {
+    return (state_.load(std::memory_order_acquire) >> detail::count_shift) == 0;
+  }
+
+  [[nodiscard]] awaiter_of<void> auto wait() noexcept {
+    struct wait_awaiter {
+      async_latch&        latch;
+      detail::waiter_node node;
+
+      bool await_ready() const noexcept {
+        return latch.try_wait();
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        node.handle = handle;
+
+        auto old = latch.state_.load(std::memory_order_acquire);
+        do {
+          if ((old >> detail::count_shift) == 0) {
+            return false;
+          }
+          node.next = detail::top_of(old);
+        } while (!latch.state_.compare_exchange_weak(old, (old & ~detail::pointer_mask) | reinterpret_cast<std::uintptr_t>(&node),
+                                                     std::memory_order_release, std::memory_order_acquire));
+
+        return true;
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    return wait_awaiter{*this, {}};
+  }
+
+private:
+  // The remaining count together with the waiter stack, so that a waiter cannot miss the count reaching zero.
+  std::atomic<std::uintptr_t> state_;
+
+  static std::uintptr_t initial_state(std::ptrdiff_t count) {
+    if (count > static_cast<std::ptrdiff_t>(detail::max_count)) {
+      throw std::invalid_argument{"async_latch: count too large"};
+    }
+    return count > 0 ? static_cast<std::uintptr_t>(count) << detail::count_shift : 0;
+  }
+};
+
+// Can be used for any number of phases. The last coroutine to arrive in a phase runs the completion, if any, resumes
+//  the others and then goes on itself. The completion must not throw.
+class async_barrier {
+public:
+  using completion_function = std::function<task<void>()>;
+
+  explicit async_barrier(std::size_t participants, completion_function completion = {})
+    : participants_{participants}
+    , completion_{std::move(completion)} {
+    if (participants == 0 || participants > detail::max_count) {
+      throw std::invalid_argument{"async_barrier: unsupported number of participants"};
+    }
+  }
+
+  async_barrier(const async_barrier&)            = delete;
+  async_barrier& operator=(const async_barrier&) = delete;
+
+  [[nodiscard]] awaiter_of<void> auto arrive_and_wait() noexcept {
+    struct arrival {
+      async_barrier&      barrier;
+      detail::waiter_node node;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) {
+        node.handle = handle;
+        return barrier.arrive(node);
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    return arrival{*this, {}};
+  }
+
+private:
+  std::size_t         participants_;
+  completion_function completion_;
+
+  // The waiter stack of the current phase together with its length, so that arriving never has to read a node that
+  //  may already have been resumed.
+  std::atomic<std::uintptr_t> state_{0};
+
+  // Returns what to transfer to: nothing until the last arrival, which runs the completion and continues afterwards.
+  //  Going through symmetric transfer keeps the stack flat even when the resumed coroutines arrive again right away.
+  std::coroutine_handle<> arrive(detail::waiter_node& node) {
+    auto old  = state_.load(std::memory_order_acquire);
+    bool last = false;
+    while (true) {
+      const auto arrived = (old >> detail::count_shift) + 1;
+
+      node.next = detail::top_of(old);
+      last      = arrived == participants_;
+
+      const auto desired = last ? 0 : reinterpret_cast<std::uintptr_t>(&node) | (arrived << detail::count_shift);
+      if (state_.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        break;
+      }
+    }
+
+    if (!last) {
+      return std::noop_coroutine();
+    }
+
+    // The next phase has started already, the rest of the stack belongs to us.
+    if (!completion_) {
+      detail::resume_all(node.next);
+      return node.handle;
+    }
+
+    const auto completion             = complete(node.next).handle;
+    completion.promise().continuation = node.handle;
+    return completion;
+  }
+
+  detail::phase_completion complete(detail::waiter_node* others) {
+    co_await completion_();
+    detail::resume_all(others);
+  }
+};
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t) {
+  co_await t;
+}
+
+constexpr int workers = 8;
+constexpr int phases  = 4;
+
+// Stands in for one worker's share of a phase of a batch job.
+std::uint64_t simulate(int worker, int phase) {
+  auto value = static_cast<std::uint64_t>(worker * phases + phase);
+  for (int i = 0; i < 1'000'000; ++i) {
+    value = value * 6'364'136'223'846'793'005ULL + 1;
+    value ^= value >> 29;
+  }
+  return value % 1'000;
+}
+
+task<void> worker(int id, async_manual_reset_event& start, async_barrier& barrier, async_latch& done, std::vector<std::uint64_t>& partial) {
+  co_await start.wait();
+
+  for (int phase = 0; phase < phases; ++phase) {
+    partial[static_cast<std::size_t>(id)] = co_await async([=] { return simulate(id, phase); });
+    co_await barrier.arrive_and_wait();
+  }
+
+  done.count_down();
+}
+
+int main() {
+  try {
+    std::vector<std::uint64_t> partial(workers);
+    std::vector<std::uint64_t> totals;
+
+    // Runs between the phases, while every worker waits: the partial results are stable.
+    async_barrier barrier{workers, [&]() -> task<void> {
+                            totals.push_back(std::accumulate(partial.begin(), partial.end(), std::uint64_t{0}));
+                            co_return;
+                          }};
+
+    async_manual_reset_event start;
+    async_latch              done{workers};
+
+    for (int id = 0; id < workers; ++id) {
+      spawn(worker(id, start, barrier, done, partial));
+    }
+
+    start.set();
+    sync_await(done.wait());
+
+    for (int phase = 0; phase < phases; ++phase) {
+      std::uint64_t expected = 0;
+      for (int id = 0; id < workers; ++id) {
+        expected += simulate(id, phase);
+      }
+
+      const auto total = totals[static_cast<std::size_t>(phase)];
+      std::cout << "phase " << phase << ": " << total << (total == expected ? "" : " (wrong)") << '\n';
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
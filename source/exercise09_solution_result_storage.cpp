@@ -0,0 +1,693 @@
+// - Keep task results in a hand-rolled tagged union instead of `std::variant`
+//   - `result_storage<T>` holds the value and the `exception_ptr` in one union slot, next to a 1-byte state; for `void`
+//     the `exception_ptr` alone suffices
+//   - `get()` is a single state compare on the success path; rethrowing lives in a separate cold function, so no
+//     exception or `bad_variant_access` code is inlined into the caller
+//   - `task<T, Storage>` takes the storage as a parameter, so frame sizes and `get()` latency can be compared against
+//     the variant-based `storage<T>` from the previous solution
+
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <semaphore>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+enum class result_state : std::uint8_t { empty, value, exception };
+
+namespace detail {
+
+// Out of line and cold, so that callers only carry a compare and a call for the failure path.
+[[noreturn, gnu::cold, gnu::noinline]] inline void rethrow_result(result_state state, const std::exception_ptr& exception) {
+  if (state == result_state::exception) {
+    std::rethrow_exception(exception);
+  }
+
+  throw std::logic_error("Result is not available yet");
+}
+
+// The stored value and the exception share a single slot: a trivially small `T` occupies the space of the
+//  `exception_ptr`, and only the state byte is added.
+template<typename Stored>
+class result_slot {
+public:
+  result_slot() noexcept {
+  }
+
+  result_slot(const result_slot&)            = delete;
+  result_slot& operator=(const result_slot&) = delete;
+
+  ~result_slot() {
+    reset();
+  }
+
+  void set_exception(std::exception_ptr ptr) noexcept {
+    // May replace a value, as a local's destructor can still throw after `co_return`.
+    reset();
+    std::construct_at(std::addressof(exception_), std::move(ptr));
+    state_ = result_state::exception;
+  }
+
+protected:
+  union {
+    Stored             value_;
+    std::exception_ptr exception_;
+  };
+  result_state state_ = result_state::empty;
+
+  // Expects no result yet.
+  template<typename... Args>
+  void emplace(Args&&... args) noexcept(std::is_nothrow_constructible_v<Stored, Args...>) {
+    std::construct_at(std::addressof(value_), std::forward<Args>(args)...);
+    state_ = result_state::value;
+  }
+
+  void check_value() const {
+    if (state_ != result_state::value) [[unlikely]] {
+      rethrow_result(state_, exception_);
+    }
+  }
+
+private:
+  void reset() noexcept {
+    if (state_ == result_state::value) {
+      std::destroy_at(std::addressof(value_));
+    } else if (state_ == result_state::exception) {
+      std::destroy_at(std::addressof(exception_));
+    }
+    state_ = result_state::empty;
+  }
+};
+
+} // namespace detail
+
+template<typename T>
+class result_storage : public detail::result_slot<T> {
+public:
+  using value_type = T;
+
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    this->emplace(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    this->check_value();
+    return this->value_;
+  }
+
+  [[nodiscard]] T&& get() && {
+    this->check_value();
+    return std::move(this->value_);
+  }
+};
+
+template<typename T>
+class result_storage<T&> : public detail::result_slot<T*> {
+public:
+  using value_type = T&;
+
+  void set_value(T& value) noexcept {
+    this->emplace(std::addressof(value));
+  }
+
+  [[nodiscard]] T& get() const {
+    this->check_value();
+    return *this->value_;
+  }
+};
+
+// Without a value, a null exception already means success and no state byte is needed.
+template<>
+class result_storage<void> {
+public:
+  using value_type = void;
+
+  void set_exception(std::exception_ptr ptr) noexcept {
+    exception_ = std::move(ptr);
+  }
+
+  void get() const {
+    if (exception_) [[unlikely]] {
+      detail::rethrow_result(result_state::exception, exception_);
+    }
+  }
+
+private:
+  std::exception_ptr exception_;
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T, template<typename> typename Storage>
+struct task_promise_storage_base : Storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T, template<typename> typename Storage = result_storage>
+struct task_promise_storage : task_promise_storage_base<T, Storage> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<template<typename> typename Storage>
+struct task_promise_storage<void, Storage> : task_promise_storage_base<void, Storage> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void, template<typename> typename Storage = result_storage>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T, Storage> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                        func_;
+  result_storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+// Coroutine frames come from the global allocator, so right after creating a task this holds the size of its frame.
+std::size_t last_allocation_size = 0;
+
+void* operator new(std::size_t size) {
+  last_allocation_size = size;
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+template<template<typename> typename Storage, typename T>
+task<T, Storage> produce(T value) {
+  co_return std::forward<T>(value);
+}
+
+template<template<typename> typename Storage, std::same_as<void> T>
+task<T, Storage> produce() {
+  co_return;
+}
+
+template<typename T, typename... Args>
+void compare_frames(std::string_view name, Args&&... args) {
+  (void)produce<storage, T>(std::forward<Args>(args)...);
+  const auto variant_frame = last_allocation_size;
+
+  (void)produce<result_storage, T>(std::forward<Args>(args)...);
+  const auto tagged_frame = last_allocation_size;
+
+  std::cout << name << ": storage " << sizeof(storage<T>) << " -> " << sizeof(result_storage<T>) << " bytes, frame " << variant_frame
+            << " -> " << tagged_frame << " bytes\n";
+}
+
+template<template<typename> typename Storage, typename T, typename Project>
+double measure_get(const T& value, Project project) {
+  constexpr std::size_t count  = 4'096;
+  constexpr std::size_t rounds = 20'000;
+
+  const auto results = std::make_unique<Storage<T>[]>(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    results[i].set_value(value);
+  }
+
+  std::size_t checksum = 0;
+  const auto  start    = std::chrono::steady_clock::now();
+  for (std::size_t round = 0; round < rounds; ++round) {
+    for (std::size_t i = 0; i < count; ++i) {
+      checksum += project(results[i].get());
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  if (checksum == 0) {
+    std::cout << "(empty checksum)\n";
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / (count * rounds);
+}
+
+template<typename T, typename Project>
+void compare_get(std::string_view name, const T& value, Project project) {
+  // Interleaved and best of several runs, to keep frequency scaling and noise out of the comparison.
+  double variant_best = 1e9;
+  double tagged_best  = 1e9;
+  for (int run = 0; run < 5; ++run) {
+    variant_best = std::min(variant_best, measure_get<storage>(value, project));
+    tagged_best  = std::min(tagged_best, measure_get<result_storage>(value, project));
+  }
+
+  std::cout << name << ": get() " << variant_best << "ns -> " << tagged_best << "ns\n";
+}
+
+task<int> answer() {
+  co_return 42;
+}
+
+task<const std::string&> greeting() {
+  static const std::string text = "Hello";
+  co_return text;
+}
+
+task<int> failing() {
+  throw std::runtime_error("Some error");
+  co_return 0;
+}
+
+task<void> print_all() {
+  std::cout << "Result: " << co_await answer() << '\n';
+  std::cout << "Result: " << co_await greeting() << '\n';
+  try {
+    std::cout << "Result: " << co_await failing() << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Exception caught: " << ex.what() << '\n';
+  }
+}
+
+int main() {
+  try {
+    sync_await(print_all());
+
+    int value = 0;
+    compare_frames<void>("void       ");
+    compare_frames<char>("char       ", 'a');
+    compare_frames<int>("int        ", 1);
+    compare_frames<int&>("int&       ", value);
+    compare_frames<double>("double     ", 1.0);
+    compare_frames<std::string>("std::string", "text");
+
+    compare_get("int        ", 1, [](int v) { return static_cast<std::size_t>(v); });
+    compare_get("std::string", std::string(32, 'x'), [](const std::string& v) { return v.size(); });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
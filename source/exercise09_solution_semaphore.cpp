@@ -0,0 +1,873 @@
+// - Limit concurrency and request rate without blocking threads
+//   - `co_await semaphore.acquire()` resumes with a permit once one is free; destroying the permit hands it on
+//   - `co_await limiter.acquire(n)` takes `n` tokens from a token bucket refilled at a fixed rate, and waits for the
+//     timer service to resume it when there are not enough yet
+//   - waiters queue up in FIFO order in intrusive lists linked through their awaiters, so waiting allocates nothing
+//   - waiters are resumed on the thread that makes room for them: the one dropping a permit, or the timer thread
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <semaphore>
+#include <stdexcept>
+#include <syncstream>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+class timer_service {
+public:
+  using clock = std::chrono::steady_clock;
+
+  timer_service()
+    : thread_{[this](std::stop_token stop) { run(stop); }} {
+  }
+
+  // Calls `fire(context)` on the timer thread once `when` has come.
+  void call_at(clock::time_point when, void (*fire)(void*), void* context) {
+    {
+      std::scoped_lock lock{mutex_};
+      timers_.push({when, sequence_++, fire, context});
+    }
+    changed_.notify_one();
+  }
+
+  [[nodiscard]] awaiter_of<void> auto sleep_until(clock::time_point when) noexcept {
+    struct sleep_awaiter {
+      timer_service&    timers;
+      clock::time_point when;
+
+      bool await_ready() const noexcept {
+        return clock::now() >= when;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) const {
+        timers.call_at(when, resume, handle.address());
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    return sleep_awaiter{*this, when};
+  }
+
+  [[nodiscard]] awaiter_of<void> auto sleep_for(clock::duration duration) noexcept {
+    return sleep_until(clock::now() + duration);
+  }
+
+private:
+  struct timer {
+    clock::time_point when;
+    std::uint64_t     sequence;
+    void (*fire)(void*);
+    void* context;
+
+    // Earliest first, FIFO among equal times.
+    friend bool operator>(const timer& lhs, const timer& rhs) noexcept {
+      return std::tie(lhs.when, lhs.sequence) > std::tie(rhs.when, rhs.sequence);
+    }
+  };
+
+  std::mutex                                                     mutex_;
+  std::condition_variable_any                                    changed_;
+  std::priority_queue<timer, std::vector<timer>, std::greater<>> timers_;
+  std::uint64_t                                                  sequence_ = 0;
+  std::jthread                                                   thread_;
+
+  static void resume(void* address) {
+    std::coroutine_handle<>::from_address(address).resume();
+  }
+
+  void run(std::stop_token stop) {
+    std::unique_lock lock{mutex_};
+    while (!stop.stop_requested()) {
+      if (timers_.empty()) {
+        changed_.wait(lock, stop, [&] { return !timers_.empty(); });
+        continue;
+      }
+
+      const auto due = timers_.top().when;
+      if (clock::now() < due) {
+        changed_.wait_until(lock, stop, due, [&] { return timers_.top().when < due; });
+        continue;
+      }
+
+      const auto next = timers_.top();
+      timers_.pop();
+
+      lock.unlock();
+      next.fire(next.context);
+      lock.lock();
+    }
+  }
+};
+
+class async_semaphore {
+  struct acquire_awaiter;
+
+public:
+  // Owns one permit of the semaphore, if not moved from.
+  class permit {
+  public:
+    permit(permit&& other) noexcept
+      : semaphore_{std::exchange(other.semaphore_, nullptr)} {
+    }
+
+    permit& operator=(permit&& other) noexcept {
+      if (this != &other) {
+        reset();
+        semaphore_ = std::exchange(other.semaphore_, nullptr);
+      }
+      return *this;
+    }
+
+    ~permit() {
+      reset();
+    }
+
+    void reset() noexcept {
+      if (auto* semaphore = std::exchange(semaphore_, nullptr)) {
+        semaphore->release();
+      }
+    }
+
+  private:
+    friend acquire_awaiter;
+
+    async_semaphore* semaphore_;
+
+    explicit permit(async_semaphore& semaphore) noexcept
+      : semaphore_{&semaphore} {
+    }
+  };
+
+  explicit async_semaphore(std::size_t permits) noexcept
+    : available_{permits} {
+  }
+
+  async_semaphore(const async_semaphore&)            = delete;
+  async_semaphore& operator=(const async_semaphore&) = delete;
+
+  // Permits are handed out in the order they were asked for.
+  [[nodiscard]] awaiter_of<permit> auto acquire() noexcept {
+    return acquire_awaiter{*this, nullptr, {}};
+  }
+
+private:
+  struct acquire_awaiter {
+    async_semaphore&        semaphore;
+    acquire_awaiter*        next = nullptr;
+    std::coroutine_handle<> handle;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      return semaphore.enqueue(*this);
+    }
+
+    permit await_resume() const noexcept {
+      return permit{semaphore};
+    }
+  };
+
+  std::mutex       mutex_;
+  std::size_t      available_;
+  acquire_awaiter* head_ = nullptr;
+  acquire_awaiter* tail_ = nullptr;
+
+  // Takes a permit or queues the awaiter; true if it has to wait.
+  bool enqueue(acquire_awaiter& waiter) {
+    std::scoped_lock lock{mutex_};
+    if (available_ > 0 && head_ == nullptr) {
+      --available_;
+      return false;
+    }
+
+    (tail_ ? tail_->next : head_) = &waiter;
+    tail_                         = &waiter;
+    return true;
+  }
+
+  // Hands the permit straight to the first waiter, so that nobody can overtake it.
+  void release() {
+    acquire_awaiter* next = nullptr;
+    {
+      std::scoped_lock lock{mutex_};
+      next = head_;
+      if (next == nullptr) {
+        ++available_;
+        return;
+      }
+
+      head_ = next->next;
+      if (head_ == nullptr) {
+        tail_ = nullptr;
+      }
+    }
+
+    next->handle.resume();
+  }
+};
+
+// A token bucket: `rate` tokens per second, of which at most `burst` can be saved up. It starts full. Waiters are only
+//  ever woken by a timer it sets while they wait, so it only has to outlive them.
+class rate_limiter {
+  using clock = timer_service::clock;
+
+public:
+  rate_limiter(timer_service& timers, double rate, double burst)
+    : timers_{timers}
+    , rate_{rate}
+    , burst_{burst}
+    , tokens_{burst}
+    , refilled_{clock::now()} {
+    if (rate <= 0 || burst <= 0) {
+      throw std::invalid_argument{"rate_limiter: rate and burst must be positive"};
+    }
+  }
+
+  rate_limiter(const rate_limiter&)            = delete;
+  rate_limiter& operator=(const rate_limiter&) = delete;
+
+  // Tokens are handed out in the order they were asked for: a large request is not overtaken by smaller ones.
+  [[nodiscard]] awaiter_of<void> auto acquire(double tokens = 1) {
+    if (tokens > burst_) {
+      throw std::invalid_argument{"rate_limiter: more tokens requested than the bucket holds"};
+    }
+
+    return acquire_awaiter{*this, tokens, nullptr, {}};
+  }
+
+private:
+  struct acquire_awaiter {
+    rate_limiter&           limiter;
+    double                  tokens;
+    acquire_awaiter*        next = nullptr;
+    std::coroutine_handle<> handle;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      return limiter.enqueue(*this);
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+  timer_service&    timers_;
+  double            rate_;
+  double            burst_;
+  std::mutex        mutex_;
+  double            tokens_;
+  clock::time_point refilled_;
+  bool              armed_ = false; // A wake-up for the first waiter is pending.
+  acquire_awaiter*  head_  = nullptr;
+  acquire_awaiter*  tail_  = nullptr;
+
+  void refill(clock::time_point now) noexcept {
+    tokens_   = std::min(burst_, tokens_ + std::chrono::duration<double>(now - refilled_).count() * rate_);
+    refilled_ = now;
+  }
+
+  // Wakes up as soon as the first waiter's tokens have been refilled.
+  void arm() {
+    if (armed_) {
+      return;
+    }
+
+    const auto wait = std::chrono::duration<double>((head_->tokens - tokens_) / rate_);
+    timers_.call_at(refilled_ + std::chrono::ceil<clock::duration>(wait), wake, this);
+    armed_ = true;
+  }
+
+  // Takes the tokens or queues the awaiter; true if it has to wait.
+  bool enqueue(acquire_awaiter& waiter) {
+    std::scoped_lock lock{mutex_};
+    refill(clock::now());
+    if (head_ == nullptr && tokens_ >= waiter.tokens) {
+      tokens_ -= waiter.tokens;
+      return false;
+    }
+
+    (tail_ ? tail_->next : head_) = &waiter;
+    tail_                         = &waiter;
+    arm();
+    return true;
+  }
+
+  static void wake(void* context) {
+    auto& self = *static_cast<rate_limiter*>(context);
+
+    // Detaches the waiters that can go now from the front of the queue.
+    acquire_awaiter* ready = nullptr;
+    {
+      std::scoped_lock lock{self.mutex_};
+      self.armed_ = false;
+      self.refill(clock::now());
+
+      acquire_awaiter* last = nullptr;
+      for (auto* waiter = self.head_; waiter && self.tokens_ >= waiter->tokens; waiter = waiter->next) {
+        self.tokens_ -= waiter->tokens;
+        last = waiter;
+      }
+
+      if (last) {
+        ready      = std::exchange(self.head_, last->next);
+        last->next = nullptr;
+      }
+
+      if (self.head_) {
+        self.arm();
+      } else {
+        self.tail_ = nullptr;
+      }
+    }
+
+    // A resumed waiter may destroy its awaiter right away.
+    while (ready) {
+      std::exchange(ready, ready->next)->handle.resume();
+    }
+  }
+};
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t, std::latch& done) {
+  co_await t;
+  done.count_down();
+}
+
+using clock_type = timer_service::clock;
+
+struct call_counters {
+  std::atomic<int> in_flight{0};
+  std::atomic<int> peak{0};
+};
+
+task<void> call_backend(async_semaphore& slots, timer_service& timers, call_counters& counters) {
+  const auto permit = co_await slots.acquire();
+
+  const int in_flight = counters.in_flight.fetch_add(1) + 1;
+  for (int peak = counters.peak.load(); peak < in_flight && !counters.peak.compare_exchange_weak(peak, in_flight);) {
+  }
+
+  co_await timers.sleep_for(std::chrono::milliseconds{5});
+  counters.in_flight.fetch_sub(1);
+}
+
+task<void> send(rate_limiter& limiter, double cost) {
+  co_await limiter.acquire(cost);
+}
+
+template<typename Func>
+clock_type::duration run_all(int count, Func make_task) {
+  std::latch done{count};
+
+  const auto start = clock_type::now();
+  for (int i = 0; i < count; ++i) {
+    spawn(make_task(i), done);
+  }
+  done.wait();
+  return clock_type::now() - start;
+}
+
+long long to_ms(clock_type::duration duration) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+int main() {
+  try {
+    timer_service timers;
+
+    {
+      constexpr int   calls = 400;
+      async_semaphore slots{8};
+      call_counters   counters;
+
+      const auto elapsed = run_all(calls, [&](int) { return call_backend(slots, timers, counters); });
+      std::cout << "semaphore: " << calls << " calls of 5ms, at most " << counters.peak << " at once, in " << to_ms(elapsed) << "ms\n";
+    }
+
+    {
+      constexpr int    requests = 1'000;
+      constexpr double rate     = 2'000;
+      constexpr double burst    = 50;
+      rate_limiter     limiter{timers, rate, burst};
+
+      const auto elapsed = run_all(requests, [&](int) { return send(limiter, 1); });
+      std::cout << "rate limiter: " << requests << " requests in " << to_ms(elapsed) << "ms, "
+                << static_cast<long long>((requests - burst) / std::chrono::duration<double>(elapsed).count()) << "/s beyond the burst of " << burst
+                << " (limit " << rate << "/s)\n";
+
+      // Every fourth request costs ten tokens; the cheap ones behind it wait their turn.
+      const auto mixed = run_all(requests, [&](int i) { return send(limiter, i % 4 == 0 ? 10 : 1); });
+      std::cout << "rate limiter, mixed costs: " << requests / 4 * 13 << " tokens in " << to_ms(mixed) << "ms\n";
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
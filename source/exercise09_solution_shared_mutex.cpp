@@ -0,0 +1,915 @@
+// - Share read-mostly state between coroutines without parking threads
+//   - `async_shared_mutex`: `co_await mutex.lock_shared()` lets any number of readers in, `co_await mutex.lock()` one
+//     writer; `scoped_lock_shared()` and `scoped_lock()` hand out an RAII lock instead
+//   - a reader gets in with a single `fetch_add` on the state word as long as no writer is around; only readers that
+//     run into a writer, and writers, take the internal mutex
+//   - writers are preferred: once a writer has asked for the lock, new readers queue behind it, so a steady stream of
+//     readers cannot starve it
+//   - when the writer unlocks, all readers queued behind it are let in together, ahead of the next writer
+//   - the benchmark runs 99% lookups and 1% updates against `std::shared_mutex` offloaded with `async` and locked
+//     right on the worker threads
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <semaphore>
+#include <shared_mutex>
+#include <syncstream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+class async_shared_mutex;
+
+// Owns an `async_shared_mutex`, shared or exclusively, and unlocks it on destruction.
+class [[nodiscard]] async_shared_mutex_lock {
+public:
+  async_shared_mutex_lock(async_shared_mutex& mutex, bool shared) noexcept
+    : mutex_{&mutex}
+    , shared_{shared} {
+  }
+
+  async_shared_mutex_lock(async_shared_mutex_lock&& other) noexcept
+    : mutex_{std::exchange(other.mutex_, nullptr)}
+    , shared_{other.shared_} {
+  }
+
+  async_shared_mutex_lock& operator=(async_shared_mutex_lock&&) = delete;
+
+  ~async_shared_mutex_lock();
+
+private:
+  async_shared_mutex* mutex_;
+  bool                shared_;
+};
+
+// Readers take the lock with a single `fetch_add` as long as no writer is around. A writer sets the writer bit first,
+//  which sends every later reader to the queue, and then waits for the readers it found to leave. When a writer
+//  unlocks, the readers that queued behind it go first, all at once, before the next writer.
+class async_shared_mutex {
+  struct waiter {
+    std::coroutine_handle<> handle;
+    waiter*                 next = nullptr;
+  };
+
+  struct lock_awaiter {
+    async_shared_mutex& mutex;
+    waiter              node;
+
+    bool await_ready() noexcept {
+      return mutex.try_lock();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      node.handle = handle;
+      return mutex.wait_exclusive(node);
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+  struct shared_lock_awaiter {
+    async_shared_mutex& mutex;
+    waiter              node;
+
+    // Counts the reader in right away; it backs out in `await_suspend` when there is a writer.
+    bool await_ready() noexcept {
+      return (mutex.state_.fetch_add(reader, std::memory_order_acquire) & writer) == 0;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      node.handle = handle;
+      return mutex.wait_shared(node);
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+public:
+  async_shared_mutex() noexcept = default;
+
+  async_shared_mutex(const async_shared_mutex&)            = delete;
+  async_shared_mutex& operator=(const async_shared_mutex&) = delete;
+
+  [[nodiscard]] bool try_lock() noexcept {
+    std::uint64_t expected = 0;
+    return state_.compare_exchange_strong(expected, writer, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] awaiter_of<void> auto lock() noexcept {
+    return lock_awaiter{*this, {}};
+  }
+
+  [[nodiscard]] awaiter_of<void> auto lock_shared() noexcept {
+    return shared_lock_awaiter{*this, {}};
+  }
+
+  [[nodiscard]] awaiter_of<async_shared_mutex_lock> auto scoped_lock() noexcept {
+    struct scoped_lock_awaiter : lock_awaiter {
+      async_shared_mutex_lock await_resume() const noexcept {
+        return {this->mutex, false};
+      }
+    };
+
+    return scoped_lock_awaiter{{*this, {}}};
+  }
+
+  [[nodiscard]] awaiter_of<async_shared_mutex_lock> auto scoped_lock_shared() noexcept {
+    struct scoped_shared_lock_awaiter : shared_lock_awaiter {
+      async_shared_mutex_lock await_resume() const noexcept {
+        return {this->mutex, true};
+      }
+    };
+
+    return scoped_shared_lock_awaiter{{*this, {}}};
+  }
+
+  void unlock_shared() {
+    // Only the last reader to leave in front of a writer has anything more to do.
+    if (state_.fetch_sub(reader, std::memory_order_release) != (reader | writer)) {
+      return;
+    }
+
+    waiter* next = nullptr;
+    {
+      std::scoped_lock lock{mutex_};
+      next = take_drained_writer(state_.load(std::memory_order_acquire));
+    }
+
+    if (next) {
+      next->handle.resume();
+    }
+  }
+
+  void unlock() {
+    waiter* readers     = nullptr;
+    waiter* next_writer = nullptr;
+    {
+      std::scoped_lock lock{mutex_};
+      readers             = std::exchange(readers_, nullptr);
+      const auto admitted = std::exchange(queued_readers_, 0) * reader;
+
+      next_writer = writers_head_;
+      if (next_writer == nullptr) {
+        // Admits the queued readers and drops the writer bit at once (modulo 2^64).
+        state_.fetch_add(admitted - writer, std::memory_order_release);
+      } else {
+        writers_head_ = next_writer->next;
+        if (writers_head_ == nullptr) {
+          writers_tail_ = nullptr;
+        }
+
+        // The next writer keeps the writer bit set and waits for the admitted readers.
+        draining_   = next_writer;
+        next_writer = take_drained_writer(state_.fetch_add(admitted, std::memory_order_acq_rel) + admitted);
+      }
+    }
+
+    // Each resumed coroutine may end its awaiter right away, so the next node is read before.
+    while (readers) {
+      std::exchange(readers, readers->next)->handle.resume();
+    }
+
+    if (next_writer) {
+      next_writer->handle.resume();
+    }
+  }
+
+private:
+  static constexpr std::uint64_t writer = 1;
+  static constexpr std::uint64_t reader = 2;
+
+  // `reader` for every reader holding the lock or about to back out, plus `writer` while a writer holds the lock or
+  //  waits for the readers to leave. The writer bit only changes under `mutex_`, or from an entirely free state.
+  std::atomic<std::uint64_t> state_{0};
+
+  std::mutex  mutex_;
+  waiter*     readers_        = nullptr; // Queued readers, in any order: they are resumed together.
+  std::size_t queued_readers_ = 0;
+  waiter*     writers_head_   = nullptr; // Queued writers, FIFO.
+  waiter*     writers_tail_   = nullptr;
+  waiter*     draining_       = nullptr; // The writer waiting for the readers to leave.
+
+  // Called under `mutex_`. Readers counted in after the snapshot see the writer bit and back out without touching the
+  //  protected state; the one bringing the count to zero then calls this again.
+  waiter* take_drained_writer(std::uint64_t snapshot) noexcept {
+    return snapshot / reader == 0 ? std::exchange(draining_, nullptr) : nullptr;
+  }
+
+  // The fast path found a writer: backs out and queues, unless the writer left meanwhile. True if it has to wait.
+  bool wait_shared(waiter& node) {
+    waiter* next = nullptr;
+    {
+      std::scoped_lock lock{mutex_};
+      if ((state_.load(std::memory_order_acquire) & writer) == 0) {
+        return false;
+      }
+
+      node.next = std::exchange(readers_, &node);
+      ++queued_readers_;
+      next = take_drained_writer(state_.fetch_sub(reader, std::memory_order_acq_rel) - reader);
+    }
+
+    if (next) {
+      next->handle.resume();
+    }
+    return true;
+  }
+
+  // Claims the writer bit, or queues behind the writer holding it. True if it has to wait.
+  bool wait_exclusive(waiter& node) {
+    std::scoped_lock lock{mutex_};
+
+    const auto old = state_.fetch_or(writer, std::memory_order_acquire);
+    if (old & writer) {
+      (writers_tail_ ? writers_tail_->next : writers_head_) = &node;
+      writers_tail_                                         = &node;
+      return true;
+    }
+
+    if (old / reader == 0) {
+      return false;
+    }
+
+    draining_ = &node;
+    return true;
+  }
+};
+
+inline async_shared_mutex_lock::~async_shared_mutex_lock() {
+  if (mutex_ == nullptr) {
+    return;
+  }
+
+  if (shared_) {
+    mutex_->unlock_shared();
+  } else {
+    mutex_->unlock();
+  }
+}
+
+// Resumes coroutines on a few threads, in FIFO order.
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads) {
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+  }
+
+  ~thread_pool() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+    ready_.notify_all();
+  }
+
+  [[nodiscard]] awaiter_of<void> auto schedule() noexcept {
+    struct schedule_awaiter {
+      thread_pool& pool;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) const {
+        pool.post(handle);
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    return schedule_awaiter{*this};
+  }
+
+private:
+  std::mutex                          mutex_;
+  std::condition_variable_any         ready_;
+  std::deque<std::coroutine_handle<>> queue_;
+  std::vector<std::jthread>           workers_;
+
+  void post(std::coroutine_handle<> handle) {
+    {
+      std::scoped_lock lock{mutex_};
+      queue_.push_back(handle);
+    }
+    ready_.notify_one();
+  }
+
+  void work(std::stop_token stop) {
+    while (true) {
+      std::coroutine_handle<> next;
+      {
+        std::unique_lock lock{mutex_};
+        if (!ready_.wait(lock, stop, [&] { return !queue_.empty(); })) {
+          return;
+        }
+        next = queue_.front();
+        queue_.pop_front();
+      }
+      next.resume();
+    }
+  }
+};
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t, std::latch& done) {
+  co_await t;
+  done.count_down();
+}
+
+constexpr std::size_t routes      = 4'096;
+constexpr int         write_every = 100; // 99% reads
+
+// A routing table: read on every request, updated now and then.
+struct routing_table {
+  std::vector<std::uint64_t> next_hop = std::vector<std::uint64_t>(routes);
+
+  [[nodiscard]] std::uint64_t lookup(std::uint64_t key) const noexcept {
+    return next_hop[key % routes];
+  }
+
+  void update(std::uint64_t key) noexcept {
+    next_hop[key % routes] += key;
+  }
+};
+
+std::uint64_t key_of(int client, int op) noexcept {
+  return static_cast<std::uint64_t>(client) * 2'654'435'761U + static_cast<std::uint64_t>(op);
+}
+
+task<void> client(thread_pool& pool, async_shared_mutex& mutex, routing_table& table, int id, int ops, std::atomic<std::uint64_t>& sink) {
+  std::uint64_t sum = 0;
+  for (int op = 0; op < ops; ++op) {
+    co_await pool.schedule();
+
+    const auto key = key_of(id, op);
+    if (op % write_every == 0) {
+      auto lock = co_await mutex.scoped_lock();
+      table.update(key);
+    } else {
+      auto lock = co_await mutex.scoped_lock_shared();
+      sum += table.lookup(key);
+    }
+  }
+  sink += sum;
+}
+
+task<void> client(thread_pool& pool, std::shared_mutex& mutex, routing_table& table, int id, int ops, std::atomic<std::uint64_t>& sink) {
+  std::uint64_t sum = 0;
+  for (int op = 0; op < ops; ++op) {
+    co_await pool.schedule();
+
+    const auto key = key_of(id, op);
+    if (op % write_every == 0) {
+      std::unique_lock lock{mutex};
+      table.update(key);
+    } else {
+      std::shared_lock lock{mutex};
+      sum += table.lookup(key);
+    }
+  }
+  sink += sum;
+}
+
+// Keeps the workers free by taking the blocking lock on a thread of its own, as `async` does.
+task<void> offloading_client(thread_pool& pool, std::shared_mutex& mutex, routing_table& table, int id, int ops, std::atomic<std::uint64_t>& sink) {
+  std::uint64_t sum = 0;
+  for (int op = 0; op < ops; ++op) {
+    co_await pool.schedule();
+
+    const auto key = key_of(id, op);
+    if (op % write_every == 0) {
+      co_await async([&mutex, &table, key] {
+        std::unique_lock lock{mutex};
+        table.update(key);
+      });
+    } else {
+      sum += co_await async([&mutex, &table, key] {
+        std::shared_lock lock{mutex};
+        return table.lookup(key);
+      });
+    }
+  }
+  sink += sum;
+}
+
+// Every update adds its key, so nothing may be missing from the table in the end.
+std::uint64_t expected_total(int clients, int ops) noexcept {
+  std::uint64_t total = 0;
+  for (int id = 0; id < clients; ++id) {
+    for (int op = 0; op < ops; op += write_every) {
+      total += key_of(id, op);
+    }
+  }
+  return total;
+}
+
+template<typename Client>
+void run(const char* name, int clients, int ops, const routing_table& table, Client make_client) {
+  thread_pool                pool{4};
+  std::atomic<std::uint64_t> sink{0};
+  std::latch                 done{clients};
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int id = 0; id < clients; ++id) {
+    spawn(make_client(pool, id, ops, sink), done);
+  }
+  done.wait();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto total = std::accumulate(table.next_hop.begin(), table.next_hop.end(), std::uint64_t{0});
+  const auto nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  std::cout << name << ": " << nanos / (static_cast<double>(clients) * ops) << " ns/op"
+            << (total == expected_total(clients, ops) ? "" : " (updates lost)") << '\n';
+}
+
+int main() {
+  try {
+    constexpr int clients = 64;
+
+    {
+      async_shared_mutex mutex;
+      routing_table      table;
+      run("async_shared_mutex         ", clients, 10'000, table, [&](thread_pool& pool, int id, int ops, std::atomic<std::uint64_t>& sink) {
+        return client(pool, mutex, table, id, ops, sink);
+      });
+    }
+
+    {
+      std::shared_mutex mutex;
+      routing_table     table;
+      run("std::shared_mutex, blocking", clients, 10'000, table, [&](thread_pool& pool, int id, int ops, std::atomic<std::uint64_t>& sink) {
+        return client(pool, mutex, table, id, ops, sink);
+      });
+    }
+
+    {
+      std::shared_mutex mutex;
+      routing_table     table;
+      run("std::shared_mutex in async ", clients, 100, table, [&](thread_pool& pool, int id, int ops, std::atomic<std::uint64_t>& sink) {
+        return offloading_client(pool, mutex, table, id, ops, sink);
+      });
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
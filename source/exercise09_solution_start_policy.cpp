@@ -0,0 +1,688 @@
+// - Select eager or lazy start of `task<T>` at compile time
+//   - `start_policy::lazy` suspends initially, as in exercise 07/09; the awaiter starts the task
+//   - `start_policy::eager` runs the body right away, as in exercise 03-06
+//   - an eager task that finishes synchronously never suspends its awaiter: `await_ready()` returns true
+//   - an eager task that does suspend races its completion against the awaiter registering itself, resolved through
+//     one atomic state word
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <semaphore>
+#include <stdexcept>
+#include <syncstream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+enum class start_policy { lazy, eager };
+
+namespace detail {
+
+template<start_policy Policy>
+struct task_continuation;
+
+template<>
+struct task_continuation<start_policy::lazy> {
+  std::coroutine_handle<> continuation = std::noop_coroutine();
+
+  static std::suspend_always initial_suspend() noexcept {
+    return {};
+  }
+
+  static bool ready(std::coroutine_handle<> self) noexcept {
+    return self.done();
+  }
+
+  std::coroutine_handle<> complete() noexcept {
+    return continuation;
+  }
+
+  // Always suspends, starting the task through symmetric transfer.
+  std::coroutine_handle<> wait(std::coroutine_handle<> awaiting, std::coroutine_handle<> self) noexcept {
+    continuation = awaiting;
+    return self;
+  }
+};
+
+template<typename Awaiter>
+struct suspend_tracking_awaiter {
+  Awaiter inner;
+  bool&   suspended;
+
+  bool await_ready() {
+    return inner.await_ready();
+  }
+
+  template<typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+    suspended = true;
+    return inner.await_suspend(handle);
+  }
+
+  decltype(auto) await_resume() {
+    return inner.await_resume();
+  }
+};
+
+template<>
+struct task_continuation<start_policy::eager> {
+  // Null while running unobserved, the promise address once completed, otherwise the awaiting coroutine.
+  std::atomic<void*> state{nullptr};
+
+  // Until the body first suspends it runs inside the call that creates the task, so nobody can be awaiting it yet.
+  bool suspended = false;
+
+  static std::suspend_never initial_suspend() noexcept {
+    return {};
+  }
+
+  template<typename A>
+  auto await_transform(A&& awaitable) {
+    return suspend_tracking_awaiter<decltype(get_awaiter(std::forward<A>(awaitable)))>{get_awaiter(std::forward<A>(awaitable)), suspended};
+  }
+
+  bool ready(std::coroutine_handle<>) const noexcept {
+    return state.load(std::memory_order_acquire) == this;
+  }
+
+  std::coroutine_handle<> complete() noexcept {
+    // Synchronous completion needs no read-modify-write, a plain store is enough for `await_ready()` to see it.
+    if (!suspended) {
+      state.store(this, std::memory_order_release);
+      return std::noop_coroutine();
+    }
+
+    if (void* awaiting = state.exchange(this, std::memory_order_acq_rel)) {
+      return std::coroutine_handle<>::from_address(awaiting);
+    }
+    return std::noop_coroutine();
+  }
+
+  // Suspends unless the task completed since `await_ready()` checked.
+  bool wait(std::coroutine_handle<> awaiting, std::coroutine_handle<>) noexcept {
+    void* expected = nullptr;
+    return state.compare_exchange_strong(expected, awaiting.address(), std::memory_order_release, std::memory_order_acquire);
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void, start_policy Policy = start_policy::lazy>
+class [[nodiscard]] task {
+public:
+  struct promise_type
+    : detail::task_promise_storage<T>
+    , detail::task_continuation<Policy> {
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().complete();
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return promise.ready(std::coroutine_handle<promise_type>::from_promise(promise));
+    }
+
+    auto await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      return promise.wait(continuation, std::coroutine_handle<promise_type>::from_promise(promise));
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<task_value_type T = void>
+using lazy_task = task<T, start_policy::lazy>;
+
+template<task_value_type T = void>
+using eager_task = task<T, start_policy::eager>;
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          auto& promise = h.promise();
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return promise.continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+// Single-threaded queue standing in for asynchronous I/O in the benchmark.
+class manual_executor {
+public:
+  [[nodiscard]] awaiter_of<void> auto schedule() noexcept {
+    struct schedule_awaiter : std::suspend_always {
+      manual_executor& executor;
+
+      void await_suspend(std::coroutine_handle<> handle) const {
+        executor.queue_.push_back(handle);
+      }
+    };
+
+    return schedule_awaiter{{}, *this};
+  }
+
+  bool run_one() {
+    if (queue_.empty()) {
+      return false;
+    }
+
+    const auto handle = queue_.front();
+    queue_.pop_front();
+    handle.resume();
+    return true;
+  }
+
+private:
+  std::deque<std::coroutine_handle<>> queue_;
+};
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+template<typename Task>
+detached_task drive(const Task& t, std::uint64_t& result, bool& done) {
+  result = co_await t;
+  done   = true;
+}
+
+template<typename Task>
+std::uint64_t run(manual_executor& executor, Task t) {
+  std::uint64_t result = 0;
+  bool          done   = false;
+
+  drive(t, result, done);
+  while (!done && executor.run_one()) {
+  }
+
+  return result;
+}
+
+constexpr int fanout = 10;
+
+// Every tenth key misses the cache and completes asynchronously.
+template<start_policy Policy>
+task<std::uint64_t, Policy> lookup(manual_executor& executor, std::uint64_t key) {
+  if (key % 10 == 0) {
+    co_await executor.schedule();
+  }
+
+  co_return key * 2;
+}
+
+template<start_policy Policy>
+task<std::uint64_t, Policy> tree(manual_executor& executor, std::uint64_t key, int depth) {
+  std::uint64_t sum = 0;
+  for (int i = 0; i < fanout; ++i) {
+    const auto child = key * fanout + static_cast<std::uint64_t>(i);
+    if (depth == 0) {
+      sum += co_await lookup<Policy>(executor, child);
+    } else {
+      sum += co_await tree<Policy>(executor, child, depth - 1);
+    }
+  }
+
+  co_return sum;
+}
+
+// Nanoseconds per leaf of a three-level call tree with 1'000 leaves.
+template<start_policy Policy>
+double measure(int iterations) {
+  manual_executor executor;
+  std::uint64_t   result = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    result += run(executor, tree<Policy>(executor, 1, 2));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  if (result != static_cast<std::uint64_t>(iterations) * 2'999'000) {
+    throw std::logic_error("Unexpected call tree result");
+  }
+
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / (iterations * fanout * fanout * fanout);
+}
+
+// Runs both policies alternately and keeps the best run of each, to filter out noise from other processes.
+void benchmark(int iterations, int runs) {
+  double lazy  = std::numeric_limits<double>::max();
+  double eager = std::numeric_limits<double>::max();
+
+  for (int i = 0; i < runs; ++i) {
+    lazy  = std::min(lazy, measure<start_policy::lazy>(iterations));
+    eager = std::min(eager, measure<start_policy::eager>(iterations));
+  }
+
+  std::cout << "lazy : " << lazy << "ns per leaf\n"
+            << "eager: " << eager << "ns per leaf\n";
+}
+
+eager_task<int> eager_func1() {
+  std::osyncstream(std::cout) << "eager_func1 started before being awaited\n";
+  co_return 42;
+}
+
+eager_task<int> eager_func2() {
+  const int result = co_await async([] { return 23; });
+  co_return result + co_await eager_func1();
+}
+
+int main() {
+  try {
+    std::cout << "Result: " << sync_await(eager_func2()) << '\n';
+
+    benchmark(5'000, 10);
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
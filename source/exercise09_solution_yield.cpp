@@ -0,0 +1,802 @@
+// - Keep long-running coroutines from monopolizing a worker
+//   - `co_await yield()` moves the current coroutine to the back of its scheduler's queue, but only when other
+//     coroutines are waiting for a worker
+//   - with a `time_slice` budget, the scheduler does the same on its own: every `co_await` inside a task counts against
+//     the slice of the worker it runs on, and once it has used up `awaits` awaits or `duration` of time, the coroutine
+//     is requeued before the awaited operation goes ahead
+//   - the slice belongs to the worker rather than a single coroutine, so whole chains of tasks awaiting each other are
+//     budgeted together; it starts over with every coroutine taken from the queue
+//   - the benchmark measures request latency next to a CPU-heavy task without yields, with manual yields and with
+//     budgets
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <latch>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <string_view>
+#include <syncstream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+using clock_type = std::chrono::steady_clock;
+
+// How long a worker keeps running the same chain of coroutines while others are waiting. Unlimited by default.
+struct time_slice {
+  std::size_t          awaits   = std::numeric_limits<std::size_t>::max();
+  clock_type::duration duration = clock_type::duration::max();
+};
+
+class fifo_scheduler {
+public:
+  fifo_scheduler(std::size_t threads, time_slice budget = {})
+    : budget_{budget} {
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+  }
+
+  // Coroutines still queued are never resumed.
+  ~fifo_scheduler() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+    ready_.notify_all();
+  }
+
+  struct operation {
+    fifo_scheduler* scheduler;
+    bool            only_if_waiting;
+
+    bool await_ready() const noexcept {
+      return scheduler == nullptr || (only_if_waiting && !scheduler->has_waiting());
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+      scheduler->post(resume, handle.address());
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+  // Resumes the awaiting coroutine on a worker, after everything queued before.
+  [[nodiscard]] operation schedule() noexcept {
+    return {this, false};
+  }
+
+  // The scheduler the calling thread works for, if any.
+  [[nodiscard]] static fifo_scheduler* current() noexcept {
+    return slice.scheduler;
+  }
+
+  // Runs `run(context)` on a worker, after everything queued before.
+  void post(void (*run)(void*), void* context) {
+    {
+      std::scoped_lock lock{mutex_};
+      queue_.push_back({run, context});
+      waiting_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ready_.notify_one();
+  }
+
+  [[nodiscard]] bool has_waiting() const noexcept {
+    return waiting_.load(std::memory_order_relaxed) > 0;
+  }
+
+  // Counts an await against the time slice of the calling worker. Returns the scheduler to requeue the awaiting
+  //  coroutine on once the slice is used up; if nothing else is waiting by then, the slice just starts over.
+  [[nodiscard]] static fifo_scheduler* charge() noexcept {
+    auto* scheduler = slice.scheduler;
+    if (scheduler == nullptr) {
+      return nullptr;
+    }
+
+    const auto& budget = scheduler->budget_;
+    if (++slice.awaits < budget.awaits && (budget.duration == clock_type::duration::max() || clock_type::now() - slice.started < budget.duration)) {
+      return nullptr;
+    }
+
+    if (!scheduler->has_waiting()) {
+      scheduler->start_slice();
+      return nullptr;
+    }
+    return scheduler;
+  }
+
+  static void resume(void* address) {
+    std::coroutine_handle<>::from_address(address).resume();
+  }
+
+private:
+  struct job {
+    void (*run)(void*);
+    void* context;
+  };
+
+  struct worker_slice {
+    fifo_scheduler*        scheduler;
+    std::size_t            awaits;
+    clock_type::time_point started;
+  };
+
+  static inline thread_local worker_slice slice{nullptr, 0, {}};
+
+  time_slice                  budget_;
+  std::mutex                  mutex_;
+  std::condition_variable_any ready_;
+  std::deque<job>             queue_;
+  std::atomic<std::size_t>    waiting_{0};
+  std::vector<std::jthread>   workers_;
+
+  void start_slice() const noexcept {
+    slice.awaits = 0;
+    if (budget_.duration != clock_type::duration::max()) {
+      slice.started = clock_type::now();
+    }
+  }
+
+  void work(std::stop_token stop) {
+    slice.scheduler = this;
+
+    while (true) {
+      job next;
+      {
+        std::unique_lock lock{mutex_};
+        if (!ready_.wait(lock, stop, [&] { return !queue_.empty(); })) {
+          return;
+        }
+
+        next = queue_.front();
+        queue_.pop_front();
+        waiting_.fetch_sub(1, std::memory_order_relaxed);
+      }
+
+      start_slice();
+      next.run(next.context);
+    }
+  }
+};
+
+// Gives way to the coroutines waiting for a worker of the current scheduler. A no-op when there are none, or when not
+//  running on a scheduler at all.
+[[nodiscard]] inline fifo_scheduler::operation yield() noexcept {
+  return {fifo_scheduler::current(), true};
+}
+
+namespace detail {
+
+// Brings the three flavors of `await_suspend` down to symmetric transfer.
+template<typename Awaiter, typename Promise>
+std::coroutine_handle<> suspend(Awaiter& awaiter, std::coroutine_handle<Promise> handle) {
+  using result = decltype(awaiter.await_suspend(handle));
+
+  if constexpr (std::is_void_v<result>) {
+    awaiter.await_suspend(handle);
+    return std::noop_coroutine();
+  } else if constexpr (std::is_same_v<result, bool>) {
+    return awaiter.await_suspend(handle) ? std::noop_coroutine() : std::coroutine_handle<>{handle};
+  } else {
+    return awaiter.await_suspend(handle);
+  }
+}
+
+// Wraps every co_await of a task: charges it to the time slice and, once that is used up, requeues the coroutine first.
+template<typename Awaitable, typename Promise>
+class budgeted_awaiter {
+public:
+  explicit budgeted_awaiter(Awaitable awaitable)
+    : inner_(detail::get_awaiter(std::forward<Awaitable>(awaitable))) {
+  }
+
+  bool await_ready() {
+    scheduler_ = fifo_scheduler::charge();
+    return scheduler_ == nullptr && inner_.await_ready();
+  }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) {
+    if (scheduler_ == nullptr) {
+      return detail::suspend(inner_, handle);
+    }
+
+    // Once posted, another worker may resume the coroutine right away, so nothing may be touched afterwards.
+    handle_ = handle;
+    scheduler_->post(resume, this);
+    return std::noop_coroutine();
+  }
+
+  decltype(auto) await_resume() {
+    return inner_.await_resume();
+  }
+
+private:
+  decltype(detail::get_awaiter(std::declval<Awaitable>())) inner_;
+  fifo_scheduler*                                         scheduler_ = nullptr;
+  std::coroutine_handle<Promise>                          handle_;
+
+  // Back on a worker with a fresh slice: the awaited operation goes ahead as it would have.
+  static void resume(void* context) {
+    auto& self = *static_cast<budgeted_awaiter*>(context);
+    if (self.inner_.await_ready()) {
+      self.handle_.resume();
+    } else {
+      detail::suspend(self.inner_, self.handle_).resume();
+    }
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+
+    // The scheduler's own operations give way already.
+    static fifo_scheduler::operation await_transform(fifo_scheduler::operation op) noexcept {
+      return op;
+    }
+
+    template<typename A>
+    detail::budgeted_awaiter<A&&, promise_type> await_transform(A&& awaitable) {
+      return detail::budgeted_awaiter<A&&, promise_type>{std::forward<A>(awaitable)};
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<std::invocable Func>
+class async {
+public:
+  using return_type = std::invoke_result_t<Func>;
+
+  template<typename F>
+  requires std::same_as<std::remove_cvref_t<F>, Func>
+  explicit async(F&& func)
+    : func_{std::forward<F>(func)} {
+  }
+
+  decltype(auto) operator co_await() & = delete; // async should be co_awaited only once (on rvalue)
+  decltype(auto) operator co_await() && {
+    struct awaiter {
+      async& awaitable;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        auto work = [&, handle]() {
+          try {
+            if constexpr (std::is_void_v<return_type>) {
+              awaitable.func_();
+            } else {
+              awaitable.result_.set_value(awaitable.func_());
+            }
+          } catch (...) {
+            awaitable.result_.set_exception(std::current_exception());
+          }
+
+          handle.resume();
+        };
+
+        std::jthread(work).detach();
+      }
+
+      decltype(auto) await_resume() {
+        return std::move(awaitable.result_).get();
+      }
+    };
+
+    return awaiter{*this};
+  }
+
+private:
+  Func                 func_;
+  storage<return_type> result_;
+};
+
+template<typename F>
+async(F) -> async<F>;
+
+namespace detail {
+
+template<typename Sync, task_value_type T>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+class [[nodiscard]] synchronized_task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    Sync*                   sync_        = nullptr;
+
+    void set_sync(Sync& sync) {
+      sync_ = &sync;
+    }
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          // The notified thread may destroy this frame right away, so nothing may be read from it afterwards.
+          auto& promise      = h.promise();
+          auto  continuation = promise.continuation;
+
+          if (promise.sync_) {
+            promise.sync_->notify_awaitable_completed();
+          }
+
+          return continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    synchronized_task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  void start(Sync& sync) const {
+    promise_->set_sync(sync);
+    std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const& {
+    return promise_->get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&& {
+    return std::move(*promise_).get();
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  synchronized_task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<awaitable A>
+using awaiter_for_t = decltype(detail::get_awaiter(std::declval<A>()));
+
+template<awaitable A>
+using await_result_t = decltype(std::declval<awaiter_for_t<A>>().await_resume());
+
+template<typename Sync, awaitable A>
+requires requires(Sync s) {
+  s.notify_awaitable_completed();
+}
+
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(A&& awaitable) {
+  co_return co_await std::forward<A>(awaitable);
+}
+
+} // namespace detail
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<detail::await_result_t<A>> sync_await(A&& awaitable) {
+  struct sync {
+    std::binary_semaphore sem{0};
+
+    void notify_awaitable_completed() {
+      sem.release();
+    }
+  };
+
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done;
+  sync_task.start(work_done);
+  work_done.sem.acquire();
+
+  // The synchronized task dies with this frame, so rvalue results are moved out instead of referenced.
+  return std::move(sync_task).get();
+}
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+detached_task spawn(task<void> t, std::latch& done) {
+  co_await t;
+  done.count_down();
+}
+
+// Stands in for real CPU-bound work.
+void spin_for(clock_type::duration duration) {
+  const auto end = clock_type::now() + duration;
+  while (clock_type::now() < end) {
+  }
+}
+
+// A small piece of a larger computation, roughly a microsecond.
+task<std::uint64_t> step(std::uint64_t value) {
+  for (int i = 0; i < 1'000; ++i) {
+    value = value * 6'364'136'223'846'793'005ULL + 1;
+    value ^= value >> 29;
+  }
+  co_return value;
+}
+
+// Never waits for anything: without yields, it keeps its worker until it is done.
+task<void> crunch(fifo_scheduler& scheduler, std::size_t steps, bool manual_yields, clock_type::time_point& finished) {
+  co_await scheduler.schedule();
+
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < steps; ++i) {
+    if (manual_yields && i % 256 == 0) {
+      co_await yield();
+    }
+    value = co_await step(value + i);
+  }
+
+  finished = clock_type::now();
+  if (value == 0) {
+    std::osyncstream(std::cout) << "unlikely\n";
+  }
+}
+
+task<void> handle_request(fifo_scheduler& scheduler, clock_type::duration& latency) {
+  const auto submitted = clock_type::now();
+
+  co_await scheduler.schedule();
+  spin_for(std::chrono::microseconds{20});
+
+  latency = clock_type::now() - submitted;
+}
+
+struct load_result {
+  std::vector<clock_type::duration> latencies;
+  clock_type::duration              crunching;
+};
+
+load_result run_load(time_slice budget, bool manual_yields) {
+  using namespace std::chrono_literals;
+
+  constexpr int         crunches = 2;
+  constexpr std::size_t steps    = 200'000;
+  constexpr int         requests = 400;
+  constexpr auto        interval = 1ms;
+
+  load_result                         result{std::vector<clock_type::duration>(requests), {}};
+  std::vector<clock_type::time_point> finished(crunches);
+  std::latch                          done{requests + crunches};
+
+  fifo_scheduler scheduler{1, budget};
+  const auto     start = clock_type::now();
+
+  for (int i = 0; i < crunches; ++i) {
+    spawn(crunch(scheduler, steps, manual_yields, finished[static_cast<std::size_t>(i)]), done);
+  }
+
+  // Open loop: requests arrive on schedule, regardless of how far behind the scheduler is.
+  for (int i = 0; i < requests; ++i) {
+    std::this_thread::sleep_until(start + i * interval);
+    spawn(handle_request(scheduler, result.latencies[static_cast<std::size_t>(i)]), done);
+  }
+
+  done.wait();
+  result.crunching = *std::max_element(finished.begin(), finished.end()) - start;
+  return result;
+}
+
+void print(std::string_view name, load_result result) {
+  std::sort(result.latencies.begin(), result.latencies.end());
+
+  const auto percentile = [&](std::size_t p) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(result.latencies[result.latencies.size() * p / 100]).count();
+  };
+
+  std::cout << name << ": requests p50 " << percentile(50) << "us, p99 " << percentile(99) << "us; crunching done after "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(result.crunching).count() << "ms\n";
+}
+
+int main() {
+  using namespace std::chrono_literals;
+
+  try {
+    print("no yields        ", run_load({}, false));
+    print("manual yields    ", run_load({}, true));
+    print("budget 256 awaits", run_load({.awaits = 256}, false));
+    print("budget 200us     ", run_load({.duration = 200us}, false));
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
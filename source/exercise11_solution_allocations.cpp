@@ -0,0 +1,110 @@
+// - Count the allocations of exercise11's generator instead of guessing them
+//   - includes `exercise11_solution.cpp` itself, with its `main` renamed, so a change there shows up here
+//   - the global `operator new` counts its calls; `expect_allocations(name, expected, func)` fails the program unless
+//     `func` allocated exactly `expected` times
+//   - the expected counts assume every coroutine frame comes from the heap, which holds for GCC; clang may elide
+//     frames (see `exercise09_halo`), so the CTest test is disabled there
+//   - a generator allocates its frame once; iterating it allocates nothing per element
+//   - there is no finished zip in the tree (exercise12 is work in progress), so `zip` here pairs up two of these
+//     generators itself: it costs one frame of its own, and nothing per element either
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <ranges>
+#include <string_view>
+#include <utility>
+
+// Its `main` is renamed and never called, so its missing `return` does not matter. GCC treats the included file as a
+//  header, and would complain about its lambdas ending up in coroutine frames.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#pragma GCC diagnostic ignored "-Wsubobject-linkage"
+#endif
+
+#define main exercise11_solution_main
+#include "exercise11_solution.cpp"
+#undef main
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+bool all_passed = true;
+
+// Runs `func` and checks that it allocated exactly `expected` times, counting the allocations of other threads too.
+template<std::invocable Func>
+void expect_allocations(std::string_view name, std::size_t expected, Func&& func) {
+  const auto before = allocations.load(std::memory_order_relaxed);
+  static_cast<void>(std::forward<Func>(func)());
+  const auto actual = allocations.load(std::memory_order_relaxed) - before;
+
+  if (actual != expected) {
+    all_passed = false;
+  }
+
+  std::cout << (actual == expected ? "ok     " : "FAILED ") << name << ": " << actual << " allocation(s), expected " << expected << '\n';
+}
+
+// Pairs up the elements of both generators until either of them ends.
+template<typename T, typename U>
+generator<std::pair<typename generator<T>::value_type, typename generator<U>::value_type>> zip(generator<T> first, generator<U> second) {
+  auto it1 = first.begin();
+  auto it2 = second.begin();
+  for (; it1 != first.end() && it2 != second.end(); ++it1, ++it2) {
+    co_yield {*it1, *it2};
+  }
+}
+
+constexpr std::size_t elements = 100'000;
+
+int main() {
+  try {
+    expect_allocations("generator creation", 1, [] { return iota(); });
+
+    expect_allocations("generator iteration", 1, [] {
+      std::uint64_t result = 0;
+      for (auto value : iota() | std::views::take(elements)) {
+        result += value;
+      }
+      return result;
+    });
+
+    expect_allocations("zip iteration", 3, [] {
+      std::uint64_t result = 0;
+      for (const auto& [index, value] : zip(iota(), fibonacci()) | std::views::take(elements)) {
+        result += index ^ value;
+      }
+      return result;
+    });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return all_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
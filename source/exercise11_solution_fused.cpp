@@ -0,0 +1,462 @@
+// - Fuse `transform`, `filter` and `take_while` stages into the generator they consume
+//   - stacking generator stages that are coroutines themselves costs one resume per stage and element
+//   - `generator | fused::transform(f) | fused::filter(p) | fused::take_while(p)` resumes the source once per element
+//     and runs the whole chain of stages inline in `operator++`, without any coroutine frame of its own
+//   - each stage runs exactly once per element and the result is kept in the iterator; `std::views::transform` before a
+//     `filter` or `take_while` calls its function again for every dereference
+//   - the fused pipeline is a view of its own, so it combines with the standard adaptors; applied to anything but an
+//     rvalue `generator` or fused pipeline, the adapters fall back to `std::views::transform`, `filter` and `take_while`
+
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *handle_.promise().value;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+generator<std::uint64_t> iota(std::uint64_t start = 0L) {
+  while (true) {
+    co_yield start++;
+  }
+}
+
+static_assert(std::input_iterator<generator<int>::iterator>);
+static_assert(std::ranges::input_range<generator<int>>);
+static_assert(std::ranges::viewable_range<generator<int>>);
+static_assert(std::ranges::view<generator<int>>);
+
+namespace fused {
+
+// What a stage does with an element: pass something on to the next stage, drop it, or end the range.
+enum class step { yield, skip, stop };
+
+template<typename F>
+struct transform_stage {
+  F f;
+
+  template<typename In>
+  using output = std::invoke_result_t<F&, In>;
+
+  template<typename In, typename Next>
+  step operator()(In&& in, Next&& next) {
+    return next(std::invoke(f, std::forward<In>(in)));
+  }
+
+  auto fallback() && {
+    return std::views::transform(std::move(f));
+  }
+};
+
+template<typename Predicate>
+struct filter_stage {
+  Predicate predicate;
+
+  template<typename In>
+  using output = In;
+
+  template<typename In, typename Next>
+  step operator()(In&& in, Next&& next) {
+    return std::invoke(predicate, std::as_const(in)) ? next(std::forward<In>(in)) : step::skip;
+  }
+
+  auto fallback() && {
+    return std::views::filter(std::move(predicate));
+  }
+};
+
+template<typename Predicate>
+struct take_while_stage {
+  Predicate predicate;
+
+  template<typename In>
+  using output = In;
+
+  template<typename In, typename Next>
+  step operator()(In&& in, Next&& next) {
+    return std::invoke(predicate, std::as_const(in)) ? next(std::forward<In>(in)) : step::stop;
+  }
+
+  auto fallback() && {
+    return std::views::take_while(std::move(predicate));
+  }
+};
+
+namespace detail {
+
+// The type that comes out of the last stage for an `In` going into the first one.
+template<typename In, typename... Stages>
+struct output {
+  using type = In;
+};
+
+template<typename In, typename Stage, typename... Rest>
+struct output<In, Stage, Rest...> : output<typename Stage::template output<In>, Rest...> {};
+
+// Passes `in` through the stages from `I` on and hands the result to `sink`. Everything inlines into one loop body.
+template<std::size_t I = 0, typename... Stages, typename In, typename Sink>
+step run(std::tuple<Stages...>& stages, In&& in, Sink& sink) {
+  if constexpr (I == sizeof...(Stages)) {
+    return sink(std::forward<In>(in));
+  } else {
+    return std::get<I>(stages)(std::forward<In>(in), [&](auto&& out) {
+      return run<I + 1>(stages, std::forward<decltype(out)>(out), sink);
+    });
+  }
+}
+
+} // namespace detail
+
+// A generator followed by stages that run on the consumer's side. The stages live on the heap, so that iterators stay
+//  valid when the view is moved.
+template<typename T, typename... Stages>
+class fused_view : public std::ranges::view_interface<fused_view<T, Stages...>> {
+  using source_iterator = typename generator<T>::iterator;
+  using output          = typename detail::output<typename generator<T>::reference, Stages...>::type;
+
+public:
+  using value_type = std::remove_cvref_t<output>;
+  using reference  = std::conditional_t<std::is_lvalue_reference_v<output>, output, const value_type&>;
+  using pointer    = std::add_pointer_t<reference>;
+
+  class iterator {
+    using result = std::conditional_t<std::is_lvalue_reference_v<output>, pointer, std::optional<fused_view::value_type>>;
+
+    source_iterator        source_;
+    std::tuple<Stages...>* stages_;
+    result                 current_{}; // Where the last result is when the stages pass on references, or a copy of it.
+    bool                   done_ = false;
+
+    friend fused_view;
+
+    iterator(source_iterator source, std::tuple<Stages...>& stages)
+      : source_{std::move(source)}
+      , stages_{&stages} {
+      settle();
+    }
+
+    // Runs the stages on the current element of the source and the following ones until one comes out at the end.
+    void settle() {
+      const auto store = [this](auto&& out) {
+        if constexpr (std::is_lvalue_reference_v<output>) {
+          current_ = std::addressof(out);
+        } else {
+          current_.emplace(std::forward<decltype(out)>(out));
+        }
+        return step::yield;
+      };
+
+      for (; !(source_ == std::default_sentinel); ++source_) {
+        switch (detail::run(*stages_, *source_, store)) {
+        case step::yield:
+          return;
+        case step::stop:
+          done_ = true;
+          return;
+        case step::skip:
+          break;
+        }
+      }
+      done_ = true;
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = fused_view::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&&) noexcept            = default;
+    iterator& operator=(iterator&&) noexcept = default;
+
+    iterator& operator++() {
+      ++source_;
+      settle();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *current_;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return done_;
+    }
+  };
+
+  fused_view(generator<T> source, std::unique_ptr<std::tuple<Stages...>> stages) noexcept
+    : source_{std::move(source)}
+    , stages_{std::move(stages)} {
+  }
+
+  [[nodiscard]] iterator begin() {
+    return iterator{source_.begin(), *stages_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+  // Appends a stage; the view is left empty.
+  template<typename Stage>
+  [[nodiscard]] fused_view<T, Stages..., Stage> then(Stage stage) && {
+    auto stages = std::make_unique<std::tuple<Stages..., Stage>>(std::tuple_cat(std::move(*stages_), std::tuple<Stage>{std::move(stage)}));
+    return {std::move(source_), std::move(stages)};
+  }
+
+private:
+  generator<T>                           source_;
+  std::unique_ptr<std::tuple<Stages...>> stages_;
+};
+
+template<typename Stage>
+struct adaptor {
+  Stage stage;
+};
+
+template<typename F>
+[[nodiscard]] adaptor<transform_stage<std::decay_t<F>>> transform(F&& f) {
+  return {{std::forward<F>(f)}};
+}
+
+template<typename Predicate>
+[[nodiscard]] adaptor<filter_stage<std::decay_t<Predicate>>> filter(Predicate&& predicate) {
+  return {{std::forward<Predicate>(predicate)}};
+}
+
+template<typename Predicate>
+[[nodiscard]] adaptor<take_while_stage<std::decay_t<Predicate>>> take_while(Predicate&& predicate) {
+  return {{std::forward<Predicate>(predicate)}};
+}
+
+template<typename T, typename Stage>
+[[nodiscard]] fused_view<T, Stage> operator|(generator<T>&& source, adaptor<Stage> next) {
+  return {std::move(source), std::make_unique<std::tuple<Stage>>(std::move(next.stage))};
+}
+
+template<typename T, typename... Stages, typename Stage>
+[[nodiscard]] fused_view<T, Stages..., Stage> operator|(fused_view<T, Stages...>&& source, adaptor<Stage> next) {
+  return std::move(source).then(std::move(next.stage));
+}
+
+template<std::ranges::viewable_range Range, typename Stage>
+[[nodiscard]] auto operator|(Range&& range, adaptor<Stage> next) {
+  return std::forward<Range>(range) | std::move(next.stage).fallback();
+}
+
+} // namespace fused
+
+static_assert(std::ranges::view<fused::fused_view<int, fused::transform_stage<int (*)(int)>>>);
+static_assert(std::ranges::input_range<fused::fused_view<int, fused::filter_stage<bool (*)(int)>>>);
+
+// The same stages as coroutines of their own, for comparison.
+template<typename T, typename F>
+generator<std::invoke_result_t<F&, const T&>> transformed(generator<T> source, F f) {
+  for (const auto& value : source) {
+    co_yield f(value);
+  }
+}
+
+template<typename T, typename Predicate>
+generator<T> filtered(generator<T> source, Predicate predicate) {
+  for (const auto& value : source) {
+    if (predicate(value)) {
+      co_yield value;
+    }
+  }
+}
+
+template<typename T, typename Predicate>
+generator<T> taken_while(generator<T> source, Predicate predicate) {
+  for (const auto& value : source) {
+    if (!predicate(value)) {
+      break;
+    }
+    co_yield value;
+  }
+}
+
+constexpr std::uint64_t limit = 1'000'000'000'000;
+
+std::uint64_t squares = 0; // Counts the calls of the first stage.
+
+std::uint64_t square(std::uint64_t x) noexcept {
+  ++squares;
+  return x * x;
+}
+
+bool not_multiple_of_3(std::uint64_t x) noexcept {
+  return x % 3 != 0;
+}
+
+std::uint64_t plus_one(std::uint64_t x) noexcept {
+  return x + 1;
+}
+
+bool below_limit(std::uint64_t x) noexcept {
+  return x < limit;
+}
+
+template<typename Range>
+void measure(const char* name, Range&& range) {
+  squares = 0;
+
+  std::uint64_t sum      = 0;
+  std::uint64_t elements = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto value : range) {
+    sum += value;
+    ++elements;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  std::cout << name << ": " << nanos / static_cast<double>(elements) << " ns/element, sum " << sum << ", "
+            << static_cast<double>(squares) / static_cast<double>(elements) << " squares/element\n";
+}
+
+int main() {
+  try {
+    for (auto i : iota() | fused::filter([](auto i) { return i % 2 == 0; }) | fused::transform([](auto i) { return i * i; }) | std::views::take(5)) {
+      std::cout << i << ' ';
+    }
+    std::cout << '\n';
+
+    measure("coroutine per stage", taken_while(transformed(filtered(transformed(iota(), square), not_multiple_of_3), plus_one), below_limit));
+    measure("std::views         ", iota() | std::views::transform(square) | std::views::filter(not_multiple_of_3) | std::views::transform(plus_one) | std::views::take_while(below_limit));
+    measure("fused              ", iota() | fused::transform(square) | fused::filter(not_multiple_of_3) | fused::transform(plus_one) | fused::take_while(below_limit));
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
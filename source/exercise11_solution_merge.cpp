@@ -0,0 +1,379 @@
+// - Merge sorted generators with a tournament tree
+//   - `merge(gen1, gen2, ..., genK, comp)` or `merge(std::vector<generator<T>>, comp)` yields the elements of all
+//     sources in `comp` order; as with a binary heap, equal elements of different sources come in no particular
+//     order
+//   - a loser tree keeps the loser of every match in its inner nodes: after the winning source has been advanced, only
+//     the matches on its path to the root are replayed, one comparison per level, so an element costs ceil(log2(K))
+//     comparisons and one resume of the source it came from
+//   - the elements are yielded by reference straight from the sources, and the source iterators are only ever moved,
+//     so move-only values merge as well
+//   - the benchmark merges K=64 shards, 100M elements in total by default, against a binary heap; the number of
+//     elements and shards can be given on the command line
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *handle_.promise().value;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+namespace detail {
+
+// Leaf `i` of a tree for `K` sources sits at node `K + i`, node `n` has the children `2n` and `2n + 1`, and node 0
+//  holds the overall winner. For any `K`, that gives every leaf a path of at most ceil(log2(K)) matches to the root.
+template<typename T, typename Compare>
+class loser_tree {
+  using iterator = typename generator<T>::iterator;
+  using pointer  = typename generator<T>::pointer;
+
+  // The matches only look at the nodes, never into the coroutine frames of the sources.
+  struct entry {
+    pointer     value; // Null once the source is exhausted.
+    std::size_t source;
+  };
+
+public:
+  loser_tree(std::vector<generator<T>>& sources, Compare& comp)
+    : comp_{comp}
+    , nodes_(std::max(sources.size(), std::size_t{1}), entry{nullptr, 0}) {
+    heads_.reserve(sources.size());
+    for (auto& source : sources) {
+      heads_.push_back(source.begin());
+    }
+
+    const auto k = heads_.size();
+    if (k == 0) {
+      return;
+    }
+
+    // Plays all matches bottom-up, keeping the winners aside.
+    std::vector<entry> winners(2 * k);
+    for (std::size_t i = 0; i < k; ++i) {
+      winners[k + i] = head(i);
+    }
+    for (auto node = k - 1; node > 0; --node) {
+      const auto& left      = winners[2 * node];
+      const auto& right     = winners[2 * node + 1];
+      const bool  left_wins = beats(left, right);
+      nodes_[node]          = left_wins ? right : left;
+      winners[node]         = left_wins ? left : right;
+    }
+    nodes_[0] = winners[1];
+  }
+
+  [[nodiscard]] bool empty() const noexcept {
+    return nodes_[0].value == nullptr;
+  }
+
+  [[nodiscard]] typename generator<T>::reference top() const noexcept {
+    return *nodes_[0].value;
+  }
+
+  // Advances the winning source and replays its path to the root.
+  void pop() {
+    const auto source = nodes_[0].source;
+    ++heads_[source];
+
+    auto winner = head(source);
+    for (auto node = (heads_.size() + source) / 2; node > 0; node /= 2) {
+      if (beats(nodes_[node], winner)) {
+        std::swap(nodes_[node], winner);
+      }
+    }
+    nodes_[0] = winner;
+  }
+
+private:
+  Compare&              comp_;
+  std::vector<iterator> heads_;
+  std::vector<entry>    nodes_; // The loser of each match; the overall winner in node 0.
+
+  [[nodiscard]] entry head(std::size_t source) const noexcept {
+    const auto& it = heads_[source];
+    return {it == std::default_sentinel ? nullptr : std::addressof(*it), source};
+  }
+
+  // Exhausted sources lose every match. Breaking ties by source would make the merge stable, but the extra branch on
+  //  the source order is as unpredictable as the data and costs more than the tree saves over a heap.
+  [[nodiscard]] bool beats(const entry& lhs, const entry& rhs) const {
+    if (rhs.value == nullptr) {
+      return true;
+    }
+    if (lhs.value == nullptr) {
+      return false;
+    }
+    return std::invoke(comp_, *lhs.value, *rhs.value);
+  }
+};
+
+} // namespace detail
+
+template<typename T, typename Compare = std::ranges::less>
+generator<T> merge(std::vector<generator<T>> sources, Compare comp = {}) {
+  detail::loser_tree<T, Compare> tree{sources, comp};
+  for (; !tree.empty(); tree.pop()) {
+    co_yield tree.top();
+  }
+}
+
+// `merge(gen1, gen2, ..., genK)` or `merge(gen1, gen2, ..., genK, comp)`.
+template<typename T, typename... Args>
+auto merge(generator<T> first, Args&&... rest) {
+  std::vector<generator<T>> sources;
+  sources.reserve(1 + sizeof...(Args));
+  sources.push_back(std::move(first));
+
+  if constexpr (sizeof...(Args) == 0 || (std::same_as<std::remove_cvref_t<Args>, generator<T>> && ...)) {
+    (sources.push_back(std::move(rest)), ...);
+    return merge(std::move(sources), std::ranges::less{});
+  } else {
+    auto args = std::forward_as_tuple(std::forward<Args>(rest)...);
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (sources.push_back(std::move(std::get<I>(args))), ...);
+    }(std::make_index_sequence<sizeof...(Args) - 1>{});
+    return merge(std::move(sources), std::move(std::get<sizeof...(Args) - 1>(args)));
+  }
+}
+
+// The textbook alternative: about 2 * log2(K) comparisons per element to restore the heap.
+template<typename T, typename Compare = std::ranges::less>
+generator<T> heap_merge(std::vector<generator<T>> sources, Compare comp = {}) {
+  std::vector<typename generator<T>::iterator> heads;
+  heads.reserve(sources.size());
+  for (auto& source : sources) {
+    heads.push_back(source.begin());
+  }
+
+  std::vector<std::size_t> heap;
+  for (std::size_t i = 0; i < heads.size(); ++i) {
+    if (!(heads[i] == std::default_sentinel)) {
+      heap.push_back(i);
+    }
+  }
+
+  const auto later = [&](std::size_t lhs, std::size_t rhs) {
+    return std::invoke(comp, *heads[rhs], *heads[lhs]);
+  };
+  std::ranges::make_heap(heap, later);
+
+  while (!heap.empty()) {
+    std::ranges::pop_heap(heap, later);
+    const auto source = heap.back();
+    co_yield *heads[source];
+
+    ++heads[source];
+    if (heads[source] == std::default_sentinel) {
+      heap.pop_back();
+    } else {
+      std::ranges::push_heap(heap, later);
+    }
+  }
+}
+
+// Sorted values with random gaps.
+generator<std::uint64_t> shard(std::uint64_t seed, std::uint64_t count) {
+  std::uint64_t state = seed * 2 + 1;
+  std::uint64_t value = 0;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    value += state % 64;
+    co_yield value;
+  }
+}
+
+std::vector<generator<std::uint64_t>> shards(std::size_t k, std::uint64_t elements) {
+  std::vector<generator<std::uint64_t>> sources;
+  for (std::size_t i = 0; i < k; ++i) {
+    // Spreads the remainder over the first shards.
+    sources.push_back(shard(i, elements / k + (i < elements % k ? 1 : 0)));
+  }
+  return sources;
+}
+
+struct counting_less {
+  std::uint64_t* comparisons;
+
+  bool operator()(std::uint64_t lhs, std::uint64_t rhs) const noexcept {
+    ++*comparisons;
+    return lhs < rhs;
+  }
+};
+
+template<typename Merge>
+void measure(std::string_view name, std::size_t k, std::uint64_t elements, Merge merge_shards) {
+  std::uint64_t comparisons = 0;
+  std::uint64_t merged      = 0;
+  std::uint64_t previous    = 0;
+  bool          sorted      = true;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto value : merge_shards(shards(k, elements), counting_less{&comparisons})) {
+    sorted   = sorted && previous <= value;
+    previous = value;
+    ++merged;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  std::cout << name << ": " << nanos / static_cast<double>(merged) << " ns/element, "
+            << static_cast<double>(comparisons) / static_cast<double>(merged) << " comparisons/element"
+            << (sorted && merged == elements ? "" : " (wrong)") << '\n';
+}
+
+generator<std::unique_ptr<int>> boxed(std::vector<int> values) {
+  for (const auto value : values) {
+    co_yield std::make_unique<int>(value);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    const std::uint64_t elements = argc > 1 ? std::stoull(argv[1]) : 100'000'000;
+    const std::size_t   k        = argc > 2 ? std::stoul(argv[2]) : 64;
+    if (k == 0) {
+      throw std::invalid_argument{"at least one shard is needed"};
+    }
+
+    const auto by_value = [](const auto& lhs, const auto& rhs) { return *lhs < *rhs; };
+    for (const auto& value : merge(boxed({1, 4, 7}), boxed({2, 5}), boxed({3, 6, 8}), by_value)) {
+      std::cout << *value << ' ';
+    }
+    std::cout << '\n';
+
+    std::cout << "K=" << k << ", " << elements << " elements\n";
+    measure("loser tree ", k, elements, [](auto sources, auto comp) { return merge(std::move(sources), comp); });
+    measure("binary heap", k, elements, [](auto sources, auto comp) { return heap_merge(std::move(sources), comp); });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,274 @@
+// - Scan large log files without building a `std::string` per line
+//   - `mmap_lines(path)` maps the file read-only and advises the kernel of sequential access
+//   - newlines are located with `memchr`, which glibc vectorizes
+//   - the generator yields `std::string_view`s pointing directly into the mapping
+//   - views stay valid as long as the generator is alive, as the mapping lives in the coroutine frame
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *handle_.promise().value;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+[[noreturn]] void throw_errno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+class mapped_file {
+public:
+  explicit mapped_file(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw_errno(path.string());
+    }
+
+    struct stat status{};
+    if (::fstat(fd, &status) < 0) {
+      ::close(fd);
+      throw_errno(path.string());
+    }
+
+    size_ = static_cast<std::size_t>(status.st_size);
+
+    // Mapping an empty file fails, an empty view is all we need then.
+    if (size_ > 0) {
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        ::close(fd);
+        throw_errno(path.string());
+      }
+
+      ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+  }
+
+  mapped_file(const mapped_file&)            = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() {
+    if (data_) {
+      ::munmap(data_, size_);
+    }
+  }
+
+  [[nodiscard]] std::string_view view() const noexcept {
+    return {static_cast<const char*>(data_), size_};
+  }
+
+private:
+  void*       data_{};
+  std::size_t size_{};
+};
+
+// Yields every line without its terminating newline; a trailing newline does not produce an empty last line.
+generator<std::string_view> mmap_lines(std::filesystem::path path) {
+  const mapped_file file{path};
+  std::string_view  rest = file.view();
+
+  while (!rest.empty()) {
+    const auto* newline = static_cast<const char*>(std::memchr(rest.data(), '\n', rest.size()));
+    const auto  length  = newline ? static_cast<std::size_t>(newline - rest.data()) : rest.size();
+
+    const auto line = rest.substr(0, length);
+    co_yield line;
+
+    rest.remove_prefix(newline ? length + 1 : length);
+  }
+}
+
+static_assert(std::ranges::input_range<generator<std::string_view>>);
+static_assert(std::ranges::view<generator<std::string_view>>);
+
+std::filesystem::path make_log(std::size_t lines) {
+  auto path = std::filesystem::temp_directory_path() / "exercise11_mmap_lines.log";
+
+  std::ofstream out{path};
+  for (std::size_t i = 0; i < lines; ++i) {
+    out << (i % 100 == 0 ? "ERROR" : "INFO ") << " request " << i << " handled by worker " << i % 16 << '\n';
+  }
+
+  return path;
+}
+
+template<typename Func>
+void measure(std::string_view name, Func&& func) {
+  const auto start  = std::chrono::steady_clock::now();
+  const auto result = std::forward<Func>(func)();
+  const auto end    = std::chrono::steady_clock::now();
+
+  std::cout << name << ": " << result << " error lines in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            << "ms\n";
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    const bool generated = argc < 2;
+    const auto path      = generated ? make_log(5'000'000) : std::filesystem::path{argv[1]};
+
+    const auto is_error = [](std::string_view line) { return line.starts_with("ERROR"); };
+
+    for (auto line : mmap_lines(path) | std::views::filter(is_error) | std::views::take(3)) {
+      std::cout << line << '\n';
+    }
+
+    measure("std::getline", [&] {
+      std::ifstream in{path};
+      std::size_t   count = 0;
+      for (std::string line; std::getline(in, line);) {
+        if (is_error(line)) {
+          ++count;
+        }
+      }
+      return count;
+    });
+
+    measure("mmap_lines", [&] {
+      std::size_t count = 0;
+      for ([[maybe_unused]] auto line : mmap_lines(path) | std::views::filter(is_error)) {
+        ++count;
+      }
+      return count;
+    });
+
+    if (generated) {
+      std::filesystem::remove(path);
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,261 @@
+// - Let consumers move the values out of a generator
+//   - `generator<T>` hands out `T&&`, so that `auto value = *it` moves; `generator<T&>` and `generator<const T&>` hand
+//     out references, as the generator of exercise11 does
+//   - `co_yield` of a prvalue or xvalue only stores its address: temporaries of the `co_yield` expression are part of
+//     the coroutine frame and live until the consumer resumes the generator
+//   - `co_yield` of an lvalue in a generator of values copies it into a slot inside the awaiter, which lives in the
+//     coroutine frame too, so that the consumer moves from the copy rather than from the coroutine's own variable
+//   - the benchmark collects long strings from a generator of references, of moved prvalues and of copied lvalues
+
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_cvref_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, T&&>;
+  using pointer    = std::add_pointer_t<reference>;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    // Temporaries of the `co_yield` expression are kept in the frame until the consumer resumes the generator.
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    // The consumer must not move from the coroutine's variable, so it gets a copy kept in the awaiter.
+    auto yield_value(const value_type& v) noexcept(std::is_nothrow_copy_constructible_v<value_type>)
+      requires std::is_rvalue_reference_v<reference>
+    {
+      struct copy_awaiter {
+        value_type copy;
+
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+          handle.promise().value = std::addressof(copy);
+        }
+
+        void await_resume() const noexcept {
+        }
+      };
+
+      return copy_awaiter{v};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return static_cast<reference>(*handle_.promise().value);
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+generator<std::uint64_t> iota(std::uint64_t start = 0L) {
+  while (true) {
+    co_yield start++;
+  }
+}
+
+static_assert(std::input_iterator<generator<std::string>::iterator>);
+static_assert(std::ranges::input_range<generator<std::string>>);
+static_assert(std::ranges::view<generator<std::string>>);
+static_assert(std::same_as<std::ranges::range_reference_t<generator<std::string>>, std::string&&>);
+static_assert(std::same_as<std::ranges::range_reference_t<generator<const std::string&>>, const std::string&>);
+
+// Counts every allocation of the program, the coroutine frames included.
+std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+constexpr std::size_t line_length = 64;
+
+// Too long for the small string buffer, so every copy allocates.
+std::string make_line(std::uint64_t number) {
+  std::string line(line_length, '.');
+  std::to_chars(line.data(), line.data() + line.size(), number);
+  return line;
+}
+
+// Hands out references to its own variable, as the generator of exercise11 does: the consumer has to copy.
+generator<const std::string&> referenced_lines(std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; ++i) {
+    const auto line = make_line(i);
+    co_yield line;
+  }
+}
+
+// Yields a prvalue: the consumer moves the line out of the temporary in the coroutine frame.
+generator<std::string> lines(std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; ++i) {
+    co_yield make_line(i);
+  }
+}
+
+// Yields an lvalue: it is copied into the frame once, and the consumer moves the copy out.
+generator<std::string> copied_lines(std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; ++i) {
+    const auto line = make_line(i);
+    co_yield line;
+  }
+}
+
+template<typename T>
+void measure(std::string_view name, generator<T> source, std::uint64_t count) {
+  std::vector<std::string> collected;
+  collected.reserve(count);
+
+  const auto allocations_before = allocations;
+  const auto start              = std::chrono::steady_clock::now();
+  for (auto line : source) {
+    collected.push_back(std::move(line));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto lines_collected = static_cast<double>(collected.size());
+  const auto nanos           = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  std::cout << name << ": " << nanos / lines_collected << " ns/line, "
+            << static_cast<double>(allocations - allocations_before) / lines_collected << " allocations/line\n";
+}
+
+int main() {
+  try {
+    for (auto i : iota() | std::views::take(10)) {
+      std::cout << i << ' ';
+    }
+    std::cout << '\n';
+
+    constexpr std::uint64_t count = 1'000'000;
+    measure("generator<const std::string&>, copied by the consumer", referenced_lines(count), count);
+    measure("generator<std::string>, prvalue moved out            ", lines(count), count);
+    measure("generator<std::string>, lvalue copied into the frame ", copied_lines(count), count);
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
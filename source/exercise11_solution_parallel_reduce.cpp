@@ -0,0 +1,688 @@
+// - Reduce over a generator on a thread pool
+//   - `parallel_reduce(gen, chunk_size, executor, init, op, f)` computes `op(init, f(x)...)` over all elements
+//   - the caller pulls chunks of `chunk_size` elements from the generator, so the generator itself stays
+//     single-threaded, and hands every chunk to a worker as a `task<R>` that maps and reduces it
+//   - partial results are combined on the caller in a balanced tree, in chunk order: `op` only has to be associative
+//     and the result does not depend on which worker finished first
+//   - at most a fixed number of chunks is in flight, which bounds the memory taken up by elements waiting for a worker
+//   - the dispatch costs (a frame, a queued job and a wake-up per chunk) disappear per element at 1'000+ elements
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <semaphore>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename... Args>
+void check_and_rethrow(const std::variant<Args...>& result) {
+  if (std::holds_alternative<std::exception_ptr>(result)) {
+    std::rethrow_exception(std::get<std::exception_ptr>(std::move(result)));
+  }
+}
+
+template<typename T>
+class storage_base {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T> result_;
+
+public:
+  template<std::convertible_to<T> U>
+  void set_value(U&& value) noexcept(std::is_nothrow_constructible_v<T, decltype(std::forward<U>(value))>) {
+    result_.template emplace<T>(std::forward<U>(value));
+  }
+
+  [[nodiscard]] const T& get() const& {
+    check_and_rethrow(this->result_);
+    return std::get<T>(this->result_);
+  }
+
+  [[nodiscard]] T&& get() && {
+    check_and_rethrow(this->result_);
+    return std::get<T>(std::move(this->result_));
+  }
+};
+
+template<typename T>
+class storage_base<T&> {
+protected:
+  std::variant<std::monostate, std::exception_ptr, T*> result_;
+
+public:
+  void set_value(T& value) noexcept {
+    result_ = std::addressof(value);
+  }
+
+  [[nodiscard]] T& get() const {
+    check_and_rethrow(this->result_);
+    return *std::get<T*>(this->result_);
+  }
+};
+
+template<>
+class storage_base<void> {
+protected:
+  std::variant<std::monostate, std::exception_ptr> result_;
+
+public:
+  void get() const {
+    check_and_rethrow(this->result_);
+  }
+};
+
+template<typename T>
+class storage : public storage_base<T> {
+public:
+  using value_type = T;
+  void set_exception(std::exception_ptr ptr) noexcept {
+    this->result_ = std::move(ptr);
+  }
+};
+
+namespace detail {
+
+template<typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+  if constexpr (requires { std::forward<T>(awaitable).operator co_await(); }) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<T>(awaitable)); }) {
+    return operator co_await(std::forward<T>(awaitable));
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+} // namespace detail
+
+namespace detail {
+
+template<typename T, template<typename...> typename Type>
+inline constexpr bool is_specialization_of = false;
+
+template<typename... Params, template<typename...> typename Type>
+inline constexpr bool is_specialization_of<Type<Params...>, Type> = true;
+
+} // namespace detail
+
+template<typename T, template<typename...> typename Type>
+concept specialization_of = detail::is_specialization_of<T, Type>;
+
+template<typename T>
+struct remove_rvalue_reference {
+  using type = T;
+};
+
+template<typename T>
+struct remove_rvalue_reference<T&&> {
+  using type = T;
+};
+
+template<typename T>
+using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
+
+namespace detail {
+
+template<typename Ret, typename Handle>
+Handle func_arg(Ret (*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle));
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) &&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&);
+
+template<typename Ret, typename T, typename Handle>
+Handle func_arg(Ret (T::*)(Handle) const&&);
+
+template<typename T>
+concept suspend_return_type = std::is_void_v<T> || std::is_same_v<T, bool> || specialization_of<T, std::coroutine_handle>;
+
+} // namespace detail
+
+template<typename T>
+concept awaiter = requires(T&& t, decltype(detail::func_arg(&std::remove_reference_t<T>::await_suspend)) arg) {
+  { std::forward<T>(t).await_ready() } -> std::convertible_to<bool>;
+  { arg } -> std::convertible_to<std::coroutine_handle<>>; // TODO Why gcc does not inherit from `std::coroutine_handle<>`?
+  { std::forward<T>(t).await_suspend(arg) } -> detail::suspend_return_type;
+  std::forward<T>(t).await_resume();
+};
+
+template<typename T, typename Value>
+concept awaiter_of = awaiter<T> && requires(T&& t) {
+  { std::forward<T>(t).await_resume() } -> std::same_as<Value>;
+};
+
+template<typename T>
+concept awaitable = requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter;
+};
+
+template<typename T, typename Value>
+concept awaitable_of = awaitable<T> && requires(T&& t) {
+  { detail::get_awaiter(std::forward<T>(t)) } -> awaiter_of<Value>;
+};
+
+template<typename T>
+concept task_value_type = std::move_constructible<T> || std::is_reference_v<T> || std::is_void_v<T>;
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+namespace detail {
+
+template<typename T>
+struct task_promise_storage_base : storage<T> {
+  void unhandled_exception() noexcept(noexcept(this->set_exception(std::current_exception()))) {
+    this->set_exception(std::current_exception());
+  }
+};
+
+template<typename T>
+struct task_promise_storage : task_promise_storage_base<T> {
+  template<typename U>
+  void return_value(U&& value) noexcept(noexcept(this->set_value(std::forward<U>(value)))) requires requires {
+    this->set_value(std::forward<U>(value));
+  }
+  { this->set_value(std::forward<U>(value)); }
+};
+
+template<>
+struct task_promise_storage<void> : task_promise_storage_base<void> {
+  void return_void() noexcept {
+  }
+};
+
+} // namespace detail
+
+template<task_value_type T = void>
+class [[nodiscard]] task {
+public:
+  struct promise_type : detail::task_promise_storage<T> {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static awaiter_of<void> auto final_suspend() noexcept {
+      struct final_awaiter : std::suspend_always {
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+      };
+
+      return final_awaiter{};
+    }
+
+    task get_return_object() noexcept {
+      return this;
+    }
+  };
+
+  awaiter_of<T> auto operator co_await() const noexcept {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<const T&> auto operator co_await() const& noexcept requires std::move_constructible<T> {
+    return awaiter(*promise_);
+  }
+
+  awaiter_of<T&&> auto operator co_await() const&& noexcept requires std::move_constructible<T> {
+    struct rvalue_awaiter : awaiter {
+      T&& await_resume() {
+        return std::move(this->promise).get();
+      }
+    };
+    return rvalue_awaiter({*promise_});
+  }
+
+private:
+  struct awaiter {
+    promise_type& promise;
+
+    bool await_ready() const noexcept {
+      return std::coroutine_handle<promise_type>::from_promise(promise).done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+      promise.continuation = continuation;
+      return std::coroutine_handle<promise_type>::from_promise(promise);
+    }
+
+    decltype(auto) await_resume() const {
+      return promise.get();
+    }
+  };
+
+  promise_ptr<promise_type> promise_;
+
+  task(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *handle_.promise().value;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+template<typename E>
+concept executor = requires(E& e, std::function<void()> work) {
+  e.execute(std::move(work));
+};
+
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads) {
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+  }
+
+  ~thread_pool() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+    ready_.notify_all();
+  }
+
+  void execute(std::function<void()> work) {
+    {
+      std::scoped_lock lock{mutex_};
+      queue_.push_back(std::move(work));
+    }
+    ready_.notify_one();
+  }
+
+private:
+  std::mutex                        mutex_;
+  std::condition_variable_any       ready_;
+  std::deque<std::function<void()>> queue_;
+  std::vector<std::jthread>         workers_;
+
+  void work(std::stop_token stop) {
+    while (true) {
+      std::function<void()> next;
+      {
+        std::unique_lock lock{mutex_};
+        if (!ready_.wait(lock, stop, [&] { return !queue_.empty(); })) {
+          return;
+        }
+        next = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      next();
+    }
+  }
+};
+
+// Resumes the awaiting coroutine on a worker of `exec`.
+template<executor Executor>
+awaiter_of<void> auto schedule_on(Executor& exec) noexcept {
+  struct schedule_awaiter {
+    Executor& exec;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+      exec.execute([handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+  return schedule_awaiter{exec};
+}
+
+namespace detail {
+
+struct detached_task {
+  struct promise_type {
+    static detached_task get_return_object() noexcept {
+      return {};
+    }
+
+    static std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    [[noreturn]] static void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+template<typename R>
+struct chunk_result {
+  std::optional<R>      value;
+  std::exception_ptr    error;
+  std::binary_semaphore done{0};
+};
+
+// Runs `work` to completion without anyone awaiting it, then signals `result`.
+template<typename R>
+detached_task start(task<R> work, chunk_result<R>& result) {
+  try {
+    result.value.emplace(co_await std::move(work));
+  } catch (...) {
+    result.error = std::current_exception();
+  }
+  result.done.release();
+}
+
+template<typename R, executor Executor, typename T, typename Reduce, typename Transform>
+task<R> reduce_chunk(Executor& exec, std::vector<T> chunk, Reduce& op, Transform& f) {
+  co_await schedule_on(exec);
+
+  R partial = std::invoke(f, chunk.front());
+  for (auto it = std::next(chunk.begin()); it != chunk.end(); ++it) {
+    partial = std::invoke(op, std::move(partial), std::invoke(f, *it));
+  }
+  co_return partial;
+}
+
+// Combines partial results in a balanced tree as they come in, in order. Two results covering the same number of
+//  chunks are merged right away, so it holds at most one result per level.
+template<typename R, typename Reduce>
+class pairwise_combiner {
+public:
+  explicit pairwise_combiner(Reduce& op) noexcept
+    : op_{op} {
+  }
+
+  void push(R value) {
+    std::size_t chunks = 1;
+    while (!levels_.empty() && levels_.back().chunks == chunks) {
+      value = std::invoke(op_, std::move(levels_.back().value), std::move(value));
+      chunks *= 2;
+      levels_.pop_back();
+    }
+    levels_.push_back({std::move(value), chunks});
+  }
+
+  [[nodiscard]] R result(R init) && {
+    for (auto& partial : levels_) {
+      init = std::invoke(op_, std::move(init), std::move(partial.value));
+    }
+    return init;
+  }
+
+private:
+  struct level {
+    R           value;
+    std::size_t chunks;
+  };
+
+  Reduce&            op_;
+  std::vector<level> levels_;
+};
+
+} // namespace detail
+
+// Computes `op(init, f(x)...)` over all elements of `source`, with `f` and the reduction of each chunk running on the
+//  workers of `exec`. The first exception, of the generator or of any chunk, is rethrown once every chunk in flight
+//  has finished.
+template<typename T, executor Executor, typename R, typename Reduce, typename Transform>
+R parallel_reduce(generator<T> source, std::size_t chunk_size, Executor& exec, R init, Reduce op, Transform f) {
+  using value_type = typename generator<T>::value_type;
+
+  // Bounds the elements held by chunks waiting for a worker.
+  constexpr std::size_t max_in_flight = 64;
+
+  chunk_size = std::max(chunk_size, std::size_t{1});
+
+  std::deque<detail::chunk_result<R>>  in_flight;
+  detail::pairwise_combiner<R, Reduce> partials{op};
+  std::exception_ptr                   error;
+
+  const auto collect = [&] {
+    auto& oldest = in_flight.front();
+    oldest.done.acquire();
+    if (error == nullptr) {
+      if (oldest.error) {
+        error = oldest.error;
+      } else {
+        partials.push(std::move(*oldest.value));
+      }
+    }
+    in_flight.pop_front();
+  };
+
+  std::vector<value_type> chunk;
+  const auto              dispatch = [&] {
+    if (in_flight.size() == max_in_flight) {
+      collect();
+    }
+
+    auto& result = in_flight.emplace_back();
+    detail::start(detail::reduce_chunk<R>(exec, std::exchange(chunk, {}), op, f), result);
+    chunk.reserve(chunk_size);
+  };
+
+  try {
+    chunk.reserve(chunk_size);
+    for (const auto& value : source) {
+      chunk.push_back(value);
+      if (chunk.size() == chunk_size) {
+        dispatch();
+        if (error) {
+          break;
+        }
+      }
+    }
+
+    if (!chunk.empty() && error == nullptr) {
+      dispatch();
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  // The chunks still refer to `op` and `f`.
+  while (!in_flight.empty()) {
+    collect();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return std::move(partials).result(std::move(init));
+}
+
+// Stands in for an expensive mapping, roughly a microsecond per 1'000 rounds.
+std::uint64_t busy_work(std::uint64_t value, std::size_t rounds) {
+  for (std::size_t i = 0; i < rounds; ++i) {
+    value = value * 6'364'136'223'846'793'005ULL + 1;
+    value ^= value >> 29;
+  }
+  return value;
+}
+
+std::uint64_t expensive(std::uint64_t value) {
+  return busy_work(value, 200) % 1'000;
+}
+
+generator<std::uint64_t> numbers(std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; ++i) {
+    co_yield i;
+  }
+}
+
+template<typename Func>
+void measure(std::string_view name, Func&& func) {
+  const auto start  = std::chrono::steady_clock::now();
+  const auto result = std::forward<Func>(func)();
+  const auto end    = std::chrono::steady_clock::now();
+
+  std::cout << name << ": " << result << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
+}
+
+int main() {
+  try {
+    constexpr std::uint64_t count = 1'000'000;
+
+    thread_pool pool{std::max(std::thread::hardware_concurrency(), 1U)};
+
+    measure("sequential          ", [] {
+      std::uint64_t sum = 0;
+      for (auto value : numbers(count)) {
+        sum += expensive(value);
+      }
+      return sum;
+    });
+
+    for (const std::size_t chunk_size : {std::size_t{1}, std::size_t{16}, std::size_t{1'024}, std::size_t{16'384}}) {
+      auto name = "chunks of " + std::to_string(chunk_size);
+      name.resize(20, ' ');
+      measure(name, [&] {
+        return parallel_reduce(numbers(count), chunk_size, pool, std::uint64_t{0}, std::plus<>{}, expensive);
+      });
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,404 @@
+// - Overlap adjacent generator stages on different cores
+//   - `parallel_stage(gen, executor, depth)` drains the upstream generator on an executor worker
+//   - elements are handed downstream through a bounded single-producer/single-consumer ring buffer
+//   - a full ring blocks the producer (backpressure), an empty ring blocks the consumer
+//   - the result is a plain `generator<T>`, so it still composes with ranges
+//   - destroying the result early stops the producer and waits for it to let go of the ring
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <semaphore>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *handle_.promise().value;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+template<typename E>
+concept executor = requires(E& e, std::function<void()> work) {
+  e.execute(std::move(work));
+};
+
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads) {
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+  }
+
+  ~thread_pool() {
+    for (auto& worker : workers_) {
+      worker.request_stop();
+    }
+    ready_.notify_all();
+  }
+
+  void execute(std::function<void()> work) {
+    {
+      std::scoped_lock lock{mutex_};
+      queue_.push_back(std::move(work));
+    }
+    ready_.notify_one();
+  }
+
+private:
+  std::mutex                        mutex_;
+  std::condition_variable_any       ready_;
+  std::deque<std::function<void()>> queue_;
+  std::vector<std::jthread>         workers_;
+
+  void work(std::stop_token stop) {
+    while (true) {
+      std::function<void()> next;
+      {
+        std::unique_lock lock{mutex_};
+        if (!ready_.wait(lock, stop, [&] { return !queue_.empty(); })) {
+          return;
+        }
+        next = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      next();
+    }
+  }
+};
+
+namespace detail {
+
+// Single-producer/single-consumer ring. The read and write positions are private to their side; the two semaphores
+//  both count the slots and provide the happens-before between writing and reading one.
+template<typename T>
+class spsc_ring {
+public:
+  explicit spsc_ring(std::size_t capacity)
+    : slots_(capacity)
+    , free_{static_cast<std::ptrdiff_t>(capacity)} {
+  }
+
+  // Blocks while the ring is full; returns false when the consumer has gone.
+  template<typename U>
+  bool push(U&& value) {
+    free_.acquire();
+    if (closed_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+
+    slots_[write_].emplace(std::forward<U>(value));
+    write_ = (write_ + 1) % slots_.size();
+    filled_.release();
+    return true;
+  }
+
+  // Blocks while the ring is empty; returns nullptr for the end-of-stream marker.
+  T* front() {
+    filled_.acquire();
+    return slots_[read_] ? std::addressof(*slots_[read_]) : nullptr;
+  }
+
+  void pop() {
+    slots_[read_].reset();
+    read_ = (read_ + 1) % slots_.size();
+    free_.release();
+  }
+
+  void push_end() {
+    free_.acquire();
+    slots_[write_].reset();
+    filled_.release();
+  }
+
+  // Called by the consumer; unblocks a producer waiting for a free slot.
+  void close() {
+    closed_.store(true, std::memory_order_relaxed);
+    free_.release();
+  }
+
+  [[nodiscard]] bool closed() const noexcept {
+    return closed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<std::optional<T>> slots_;
+  std::size_t                   write_ = 0;
+  std::size_t                   read_  = 0;
+  std::counting_semaphore<>     free_;
+  std::counting_semaphore<>     filled_{0};
+  std::atomic<bool>             closed_{false};
+};
+
+template<typename T>
+class stage_channel {
+public:
+  explicit stage_channel(std::size_t depth)
+    : ring_{depth} {
+  }
+
+  template<typename U>
+  void produce(generator<U>& upstream) noexcept {
+    try {
+      for (auto&& value : upstream) {
+        if (!ring_.push(std::forward<decltype(value)>(value))) {
+          break;
+        }
+      }
+    } catch (...) {
+      error_ = std::current_exception();
+    }
+
+    if (!ring_.closed()) {
+      ring_.push_end();
+    }
+
+    finished_.test_and_set();
+    finished_.notify_one();
+  }
+
+  [[nodiscard]] T* front() {
+    return ring_.front();
+  }
+
+  void pop() {
+    ring_.pop();
+  }
+
+  void rethrow_if_failed() const {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+  // Stops the producer (if still running) and waits until it no longer touches the channel.
+  void join() {
+    ring_.close();
+    finished_.wait(false);
+  }
+
+private:
+  spsc_ring<T>       ring_;
+  std::exception_ptr error_;
+  std::atomic_flag   finished_;
+};
+
+} // namespace detail
+
+// Runs `upstream` on a worker of `executor`, buffering at most `depth` elements ahead of the consumer. The executor
+//  must have a worker available for every active stage, as each stage occupies one for its whole lifetime.
+template<typename T, executor Executor>
+generator<std::remove_cvref_t<T>> parallel_stage(generator<T> upstream, Executor& exec, std::size_t depth) {
+  using value_type = std::remove_cvref_t<T>;
+
+  // One extra slot holds the end-of-stream marker.
+  detail::stage_channel<value_type> channel{depth + 1};
+
+  struct joiner {
+    detail::stage_channel<value_type>& channel;
+
+    ~joiner() {
+      channel.join();
+    }
+  };
+
+  exec.execute([&] { channel.produce(upstream); });
+  const joiner join{channel};
+
+  while (auto* value = channel.front()) {
+    co_yield static_cast<const value_type&>(*value);
+    channel.pop();
+  }
+
+  channel.rethrow_if_failed();
+}
+
+static_assert(std::ranges::input_range<decltype(parallel_stage(std::declval<generator<int>>(), std::declval<thread_pool&>(), 1))>);
+
+// Stands in for the real per-element cost of a stage, roughly a microsecond per 1'000 rounds.
+std::uint64_t busy_work(std::uint64_t value, std::size_t rounds) {
+  for (std::size_t i = 0; i < rounds; ++i) {
+    value = value * 6'364'136'223'846'793'005ULL + 1;
+    value ^= value >> 29;
+  }
+  return value;
+}
+
+generator<std::uint64_t> parse(std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; ++i) {
+    const auto value = busy_work(i, 2'000) % 1'000;
+    co_yield value;
+  }
+}
+
+generator<std::uint64_t> transform(generator<std::uint64_t> input) {
+  for (auto value : input) {
+    const auto transformed = busy_work(value, 2'000) % 1'000;
+    co_yield transformed;
+  }
+}
+
+template<typename Range>
+std::uint64_t aggregate(Range&& input) {
+  std::uint64_t sum = 0;
+  for (auto value : input) {
+    sum += value % 2 == 0 ? busy_work(value, 2'000) % 1'000 : 0;
+  }
+  return sum;
+}
+
+template<typename Func>
+void measure(std::string_view name, Func&& func) {
+  const auto start  = std::chrono::steady_clock::now();
+  const auto result = std::forward<Func>(func)();
+  const auto end    = std::chrono::steady_clock::now();
+
+  std::cout << name << ": " << result << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
+}
+
+int main() {
+  try {
+    constexpr std::uint64_t count = 100'000;
+    constexpr std::size_t   depth = 256;
+
+    thread_pool pool{2};
+
+    measure("sequential", [] { return aggregate(transform(parse(count))); });
+    measure("parallel  ", [&] { return aggregate(parallel_stage(transform(parallel_stage(parse(count), pool, depth)), pool, depth)); });
+
+    // Dropping the pipeline early stops the producers.
+    auto first = parallel_stage(transform(parallel_stage(parse(count), pool, depth)), pool, depth) | std::views::take(5);
+    for (auto value : first) {
+      std::cout << value << ' ';
+    }
+    std::cout << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,107 @@
+// - Count the allocations of the channel between parallel stages instead of guessing them
+//   - includes `exercise11_solution_parallel_stage.cpp` itself, with its `main` renamed, so a change there shows up here
+//   - the global `operator new` counts its calls; `expect_allocations(name, expected, func)` fails the program unless
+//     `func` allocated exactly `expected` times
+//   - the expected counts assume every coroutine frame comes from the heap, which holds for GCC; clang may elide
+//     frames (see `exercise09_halo`), so the CTest test is disabled there
+//   - the ring buffer allocates its slots once and nothing per element
+//   - a parallel stage allocates its frame, its ring and nothing else: its job fits into `std::function` itself
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <utility>
+
+// Its `main` is renamed and never called, so its missing `return` does not matter. GCC treats the included file as a
+//  header, and would complain about its lambdas ending up in coroutine frames.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#pragma GCC diagnostic ignored "-Wsubobject-linkage"
+#endif
+
+#define main exercise11_solution_parallel_stage_main
+#include "exercise11_solution_parallel_stage.cpp"
+#undef main
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+bool all_passed = true;
+
+// Runs `func` and checks that it allocated exactly `expected` times, counting the allocations of other threads too.
+template<std::invocable Func>
+void expect_allocations(std::string_view name, std::size_t expected, Func&& func) {
+  const auto before = allocations.load(std::memory_order_relaxed);
+  static_cast<void>(std::forward<Func>(func)());
+  const auto actual = allocations.load(std::memory_order_relaxed) - before;
+
+  if (actual != expected) {
+    all_passed = false;
+  }
+
+  std::cout << (actual == expected ? "ok     " : "FAILED ") << name << ": " << actual << " allocation(s), expected " << expected << '\n';
+}
+
+generator<std::uint64_t> numbers(std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; ++i) {
+    co_yield i;
+  }
+}
+
+constexpr std::uint64_t elements = 100'000;
+
+int main() {
+  try {
+    expect_allocations("spsc_ring push/pop", 1, [] {
+      detail::spsc_ring<std::uint64_t> ring{64};
+      std::uint64_t                    result = 0;
+      for (std::uint64_t i = 0; i < elements; ++i) {
+        ring.push(i);
+        result += *ring.front();
+        ring.pop();
+      }
+      return result;
+    });
+
+    // The frames of the stage and of its upstream generator, and the ring.
+    thread_pool pool{1};
+    expect_allocations("parallel_stage", 3, [&] {
+      std::uint64_t result = 0;
+      for (auto value : parallel_stage(numbers(elements), pool, 64)) {
+        result += value;
+      }
+      return result;
+    });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return all_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
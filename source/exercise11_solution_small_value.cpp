@@ -0,0 +1,295 @@
+// - Keep small yielded values in the promise instead of pointing at them
+//   - `generator<T>` for a trivially copyable and assignable `T` of at most 16 bytes copies every yielded value into
+//     its promise, and `operator*` returns a copy of it: no pointer to a variable of the coroutine, and no indirection
+//     per element
+//   - other types keep the pointer to the yielded object, as in exercise11, so nothing large is ever copied
+//   - `generator<T, false>` forces the pointer for the comparison: the benchmark runs `iota`, `fibonacci` and a
+//     ranges pipeline both ways
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+// Copying one of these is as cheap as copying the pointer to it. The promise also has to hold one before the first
+//  `co_yield` and overwrite it on every other.
+template<typename T>
+inline constexpr bool yields_by_value = !std::is_reference_v<T> && std::is_trivially_copyable_v<T> && sizeof(T) <= 16 &&
+                                        std::is_trivially_default_constructible_v<T> && std::is_copy_assignable_v<T>;
+
+namespace detail {
+
+// Where the promise keeps the current value: the address of the yielded object...
+template<typename T, bool ByValue>
+struct yielded_value {
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  pointer current;
+
+  void store(reference v) noexcept {
+    current = std::addressof(v);
+  }
+
+  [[nodiscard]] reference load() const noexcept {
+    return *current;
+  }
+
+  [[nodiscard]] pointer address() const noexcept {
+    return current;
+  }
+};
+
+// ... or a copy of it.
+template<typename T>
+struct yielded_value<T, true> {
+  using value_type = T;
+  using reference  = T;
+  using pointer    = const T*;
+
+  T current;
+
+  void store(const T& v) noexcept {
+    current = v;
+  }
+
+  [[nodiscard]] T load() const noexcept {
+    return current;
+  }
+
+  [[nodiscard]] pointer address() const noexcept {
+    return std::addressof(current);
+  }
+};
+
+} // namespace detail
+
+template<typename T, bool ByValue = yields_by_value<T>>
+class [[nodiscard]] generator {
+  using slot = detail::yielded_value<T, ByValue>;
+
+public:
+  using value_type = typename slot::value_type;
+  using reference  = typename slot::reference;
+  using pointer    = typename slot::pointer;
+
+  struct promise_type {
+    slot value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(const std::remove_reference_t<reference>& v) noexcept {
+      value.store(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return handle_.promise().value.load();
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return handle_.promise().value.address();
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T, bool ByValue>
+inline constexpr bool std::ranges::enable_view<generator<T, ByValue>> = true;
+
+template<bool ByValue = true>
+generator<std::uint64_t, ByValue> iota(std::uint64_t start = 0L) {
+  while (true) {
+    co_yield start++;
+  }
+}
+
+template<bool ByValue = true>
+generator<std::uint64_t, ByValue> fibonacci() {
+  std::uint64_t a = 0, b = 1;
+  while (true) {
+    co_yield b;
+    a = std::exchange(b, a + b);
+  }
+}
+
+generator<std::string> words() {
+  co_yield "by";
+  co_yield "reference";
+}
+
+static_assert(std::same_as<std::iter_reference_t<generator<std::uint64_t>::iterator>, std::uint64_t>);
+static_assert(std::same_as<std::iter_reference_t<generator<std::uint64_t, false>::iterator>, const std::uint64_t&>);
+static_assert(std::same_as<std::iter_reference_t<generator<std::string>::iterator>, const std::string&>);
+static_assert(std::input_iterator<generator<int>::iterator>);
+static_assert(std::ranges::view<generator<int>>);
+static_assert(std::ranges::view<generator<std::string>>);
+
+// Cannot be assigned to, so it has to be yielded by address.
+struct point {
+  const int x;
+  int       y;
+};
+
+static_assert(!yields_by_value<point>);
+
+constexpr std::ptrdiff_t count = 100'000'000;
+
+// The best of a few runs, as the differences are small.
+template<typename Func>
+void measure(std::string_view name, Func&& func) {
+  constexpr int runs = 3;
+
+  auto best   = std::chrono::steady_clock::duration::max();
+  auto result = func();
+  for (int i = 0; i < runs; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    result           = func();
+    best             = std::min(best, std::chrono::steady_clock::now() - start);
+  }
+
+  const auto nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(best).count());
+  std::cout << name << ": " << nanos / static_cast<double>(count) << " ns/element (" << result << ")\n";
+}
+
+template<bool ByValue>
+void run(std::string_view storage) {
+  std::cout << storage << '\n';
+
+  measure("  iota     ", [] {
+    std::uint64_t sum = 0;
+    for (const auto value : iota<ByValue>() | std::views::take(count)) {
+      sum += value;
+    }
+    return sum;
+  });
+
+  measure("  fibonacci", [] {
+    std::uint64_t mix = 0;
+    for (const auto value : fibonacci<ByValue>() | std::views::take(count)) {
+      mix ^= value;
+    }
+    return mix;
+  });
+
+  measure("  pipeline ", [] {
+    auto squares = iota<ByValue>() | std::views::filter([](auto value) { return value % 3 != 0; }) |
+                   std::views::transform([](auto value) { return value * value; }) | std::views::take(count);
+
+    std::uint64_t sum = 0;
+    for (const auto value : squares) {
+      sum += value;
+    }
+    return sum;
+  });
+}
+
+int main() {
+  try {
+    for (const auto& word : words()) {
+      std::cout << word << ' ';
+    }
+    std::cout << '\n';
+
+    run<false>("pointer to the yielded value:");
+    run<true>("value in the promise:");
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}
@@ -0,0 +1,385 @@
+// - Sliding and tumbling windows over a generator
+//   - `windowed(gen, size, step)` yields a `std::span` over the last `size` elements, first once `size` elements have
+//     come in and then after every `step` more: `step == 1` slides by one element, `step == size` gives tumbling
+//     windows, and `step > size` hopping ones with gaps in between
+//   - the elements are kept in a mirrored ring: every element is written twice, `size` slots apart, so that the window
+//     is one contiguous run of memory however the ring has wrapped around; no window is ever copied
+//   - a span stays valid until the generator is advanced
+//   - `rolling(gen, size, step, aggregates...)` yields the values of incremental aggregates for the same windows;
+//     `rolling_sum`, `rolling_min` and `rolling_max` cost O(1) amortized per element instead of O(size) per window,
+//     min and max by way of a monotonic deque
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct coro_deleter {
+  template<typename Promise>
+  void operator()(Promise* promise) const noexcept {
+    if (auto handle = std::coroutine_handle<Promise>::from_promise(*promise); handle) {
+      handle.destroy();
+    }
+  }
+};
+
+template<typename T>
+using promise_ptr = std::unique_ptr<T, coro_deleter>;
+
+template<typename T>
+class [[nodiscard]] generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference  = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer    = const value_type*;
+
+  struct promise_type {
+    pointer value;
+
+    static std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    static std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    static void return_void() noexcept {
+    }
+
+    generator<T> get_return_object() noexcept {
+      return this;
+    }
+
+    std::suspend_always yield_value(reference v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+
+    void unhandled_exception() {
+      throw;
+    }
+
+    // Disallow co_await in generator coroutines.
+    void await_transform() = delete;
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+    friend generator;
+
+    explicit iterator(promise_type& promise) noexcept
+      : handle_{std::coroutine_handle<promise_type>::from_promise(promise)} {
+    }
+
+  public:
+    // Required for ranges (names are predetermined).
+    using value_type      = generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    iterator& operator=(iterator&& other) noexcept {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+      return *handle_.promise().value;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept {
+      return handle_.done();
+    }
+  };
+
+  [[nodiscard]] iterator begin() {
+    auto handle = std::coroutine_handle<promise_type>::from_promise(*promise_);
+    handle.resume();
+    return iterator{*promise_};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+
+  generator(promise_type* promise)
+    : promise_(promise) {
+  }
+};
+
+template<typename T>
+inline constexpr bool std::ranges::enable_view<generator<T>> = true;
+
+namespace detail {
+
+// Keeps the last `size` elements twice, at `i` and `i + size`, so that they always form one contiguous run starting
+//  with the oldest of them.
+template<typename T>
+class mirrored_ring {
+public:
+  explicit mirrored_ring(std::size_t size)
+    : slots_(2 * size)
+    , size_{size} {
+  }
+
+  void push(const T& value) {
+    slots_[next_]         = value;
+    slots_[next_ + size_] = value;
+    next_                 = next_ + 1 == size_ ? 0 : next_ + 1;
+  }
+
+  // Only complete once `size` elements have been pushed.
+  [[nodiscard]] std::span<const T> window() const noexcept {
+    return {slots_.data() + next_, size_};
+  }
+
+private:
+  std::vector<T> slots_;
+  std::size_t    size_;
+  std::size_t    next_ = 0; // The oldest element, which the next push overwrites.
+};
+
+inline void check_window(std::size_t size, std::size_t step) {
+  if (size == 0 || step == 0) {
+    throw std::invalid_argument{"window size and step must be positive"};
+  }
+}
+
+template<typename T>
+generator<std::span<const typename generator<T>::value_type>> windows(generator<T> source, std::size_t size, std::size_t step) {
+  mirrored_ring<typename generator<T>::value_type> ring{size};
+
+  std::size_t until_window = size;
+  for (const auto& value : source) {
+    ring.push(value);
+    if (--until_window == 0) {
+      co_yield ring.window();
+      until_window = step;
+    }
+  }
+}
+
+template<typename T, typename... Aggregates>
+generator<std::tuple<typename Aggregates::value_type...>> rolling_windows(generator<T> source, std::size_t size, std::size_t step, Aggregates... aggregates) {
+  // The aggregates are told about the elements leaving the window, so the last `size` have to be kept around.
+  std::vector<typename generator<T>::value_type> last(size);
+  std::size_t                                    next = 0;
+  bool                                           full = false;
+
+  std::size_t until_window = size;
+  for (const auto& value : source) {
+    if (full) {
+      (aggregates.pop(last[next]), ...);
+    }
+    (aggregates.push(value), ...);
+
+    last[next] = value;
+    if (++next == size) {
+      next = 0;
+      full = true;
+    }
+
+    if (--until_window == 0) {
+      co_yield std::tuple<typename Aggregates::value_type...>{aggregates.value()...};
+      until_window = step;
+    }
+  }
+}
+
+} // namespace detail
+
+// The elements must be default constructible and copy assignable.
+template<typename T>
+generator<std::span<const typename generator<T>::value_type>> windowed(generator<T> source, std::size_t size, std::size_t step = 1) {
+  detail::check_window(size, step);
+  return detail::windows(std::move(source), size, step);
+}
+
+// An aggregate sees every element once as it enters the window (`push`) and once as it leaves (`pop`), in the same
+//  order; `value()` is the aggregate of the elements in between.
+template<typename T, typename... Aggregates>
+generator<std::tuple<typename Aggregates::value_type...>> rolling(generator<T> source, std::size_t size, std::size_t step, Aggregates... aggregates) {
+  detail::check_window(size, step);
+  return detail::rolling_windows(std::move(source), size, step, std::move(aggregates)...);
+}
+
+template<typename T>
+class rolling_sum {
+public:
+  using value_type = T;
+
+  void push(const T& value) {
+    sum_ += value;
+  }
+
+  void pop(const T& value) {
+    sum_ -= value;
+  }
+
+  [[nodiscard]] const T& value() const noexcept {
+    return sum_;
+  }
+
+private:
+  T sum_{};
+};
+
+// Keeps only the elements that can still become the extreme: each one is more extreme than all that came before it
+//  and are still there. An element enters and leaves the deque once, so each costs O(1) amortized.
+template<typename T, typename Compare>
+class rolling_extreme {
+public:
+  using value_type = T;
+
+  void push(const T& value) {
+    while (!candidates_.empty() && !std::invoke(comp_, candidates_.back().value, value)) {
+      candidates_.pop_back();
+    }
+    candidates_.push_back({pushed_++, value});
+  }
+
+  void pop(const T&) {
+    if (candidates_.front().sequence == popped_++) {
+      candidates_.pop_front();
+    }
+  }
+
+  [[nodiscard]] const T& value() const noexcept {
+    return candidates_.front().value;
+  }
+
+private:
+  struct candidate {
+    std::uint64_t sequence;
+    T             value;
+  };
+
+  [[no_unique_address]] Compare comp_;
+  std::deque<candidate>         candidates_;
+  std::uint64_t                 pushed_ = 0;
+  std::uint64_t                 popped_ = 0;
+};
+
+template<typename T>
+using rolling_min = rolling_extreme<T, std::less<T>>;
+
+template<typename T>
+using rolling_max = rolling_extreme<T, std::greater<T>>;
+
+generator<int> count_to(int last) {
+  for (int i = 1; i <= last; ++i) {
+    co_yield i;
+  }
+}
+
+// Request latencies in microseconds, with the odd slow one.
+generator<std::uint64_t> latencies(std::uint64_t count) {
+  std::uint64_t state = 88'172'645'463'325'252ULL;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    co_yield state % 100 == 0 ? 5'000 + state % 20'000 : 200 + state % 300;
+  }
+}
+
+struct totals {
+  std::uint64_t windows = 0;
+  std::uint64_t sums    = 0;
+  std::uint64_t mins    = 0;
+  std::uint64_t maxs    = 0;
+};
+
+template<typename Func>
+void measure(std::string_view name, Func&& func) {
+  const auto start  = std::chrono::steady_clock::now();
+  const auto result = std::forward<Func>(func)();
+  const auto end    = std::chrono::steady_clock::now();
+
+  std::cout << name << ": " << result.windows << " windows, checksum " << (result.sums ^ result.mins ^ result.maxs) << " in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
+}
+
+int main() {
+  try {
+    for (const auto window : windowed(count_to(10), 3, 3)) {
+      std::cout << '[';
+      for (const auto value : window) {
+        std::cout << ' ' << value;
+      }
+      std::cout << " ] ";
+    }
+    std::cout << '\n';
+
+    for (const auto& [sum, low, high] : rolling(count_to(10), 4, 2, rolling_sum<int>{}, rolling_min<int>{}, rolling_max<int>{})) {
+      std::cout << sum << '/' << low << '/' << high << ' ';
+    }
+    std::cout << '\n';
+
+    constexpr std::uint64_t count = 1'000'000;
+    constexpr std::size_t   size  = 1'000;
+    constexpr std::size_t   step  = 1;
+
+    measure("windowed, recomputed", [] {
+      totals result;
+      for (const auto window : windowed(latencies(count), size, step)) {
+        const auto [low, high] = std::ranges::minmax(window);
+        ++result.windows;
+        result.sums += std::accumulate(window.begin(), window.end(), std::uint64_t{0});
+        result.mins += low;
+        result.maxs += high;
+      }
+      return result;
+    });
+
+    measure("rolling             ", [] {
+      totals result;
+      for (const auto& [sum, low, high] :
+           rolling(latencies(count), size, step, rolling_sum<std::uint64_t>{}, rolling_min<std::uint64_t>{}, rolling_max<std::uint64_t>{})) {
+        ++result.windows;
+        result.sums += sum;
+        result.mins += low;
+        result.maxs += high;
+      }
+      return result;
+    });
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << "\n";
+  }
+}